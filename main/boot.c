@@ -0,0 +1,103 @@
+#include "boot.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_system.h"
+#endif
+
+static const char *TAG = "BOOT";
+
+static const char *const phase_names[BOOT_PHASE_COUNT] = {
+    "app_main", "can_listening", "nvs", "httpd", "wifi", "diag", "capture", "first_frame", "first_page",
+};
+
+static EventGroupHandle_t boot_events;
+static int64_t phase_us[BOOT_PHASE_COUNT];
+
+esp_err_t boot_init(void) {
+    boot_events = xEventGroupCreate();
+    return boot_events != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void boot_mark(boot_phase_t phase) {
+    if (boot_reached(phase)) {
+        return;
+    }
+    // Several tasks mark phases, but each phase from one place only.
+    phase_us[phase] = esp_timer_get_time();
+    xEventGroupSetBits(boot_events, BOOT_BIT(phase));
+    ESP_LOGI(TAG, "%s at %" PRId64 " ms", phase_names[phase], phase_us[phase] / 1000);
+}
+
+bool boot_reached(boot_phase_t phase) {
+    return (xEventGroupGetBits(boot_events) & BOOT_BIT(phase)) != 0;
+}
+
+bool boot_wait(EventBits_t bits, TickType_t timeout) {
+    return (xEventGroupWaitBits(boot_events, bits, pdFALSE, pdTRUE, timeout) & bits) == bits;
+}
+
+bool boot_gate(httpd_req_t *req, EventBits_t bits) {
+    if ((xEventGroupGetBits(boot_events) & bits) == bits) {
+        return true;
+    }
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    httpd_resp_sendstr(req, "Starting up");
+    return false;
+}
+
+static const char *reset_reason(void) {
+#if CONFIG_IDF_TARGET_LINUX
+    return "unknown";
+#else
+    switch (esp_reset_reason()) {
+    case ESP_RST_POWERON:   return "poweron";
+    case ESP_RST_SW:        return "software";
+    case ESP_RST_PANIC:     return "panic";
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:       return "watchdog";
+    case ESP_RST_BROWNOUT:  return "brownout";
+    case ESP_RST_DEEPSLEEP: return "deepsleep";
+    default:                return "other";
+    }
+#endif
+}
+
+// GET /boot: reset reason and the time of each phase, in microseconds
+static esp_err_t boot_get_handler(httpd_req_t *req) {
+    char response[384];
+    EventBits_t reached = xEventGroupGetBits(boot_events);
+    size_t len = snprintf(response, sizeof(response), "{\"reset_reason\":\"%s\",\"phases\":{", reset_reason());
+    for (int i = 0; i < BOOT_PHASE_COUNT && len < sizeof(response); i++) {
+        len += (reached & BOOT_BIT(i))
+            ? snprintf(response + len, sizeof(response) - len, "%s\"%s\":%" PRId64, i ? "," : "",
+                       phase_names[i], phase_us[i])
+            : snprintf(response + len, sizeof(response) - len, "%s\"%s\":null", i ? "," : "", phase_names[i]);
+    }
+    if (len < sizeof(response)) {
+        len += snprintf(response + len, sizeof(response) - len, "}}");
+    }
+    if (len >= sizeof(response)) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, response, len);
+}
+
+esp_err_t boot_register(httpd_handle_t server) {
+    httpd_uri_t uri_boot = {
+        .uri       = "/boot",
+        .method    = HTTP_GET,
+        .handler   = boot_get_handler,
+        .user_ctx  = NULL
+    };
+    return httpd_register_uri_handler(server, &uri_boot);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+// Boot phases and readiness. The devices are power-cycled with the
+// ignition, so app_main brings the CAN path up first and starts NVS,
+// Wi-Fi and the web server on their own task while the diagnostic
+// services initialise. Each phase sets its bit in an event group the first
+// time it is reached, and its time (esp_timer, i.e. since shortly after
+// the bootloader hands over) is kept for GET /boot:
+//
+// {"reset_reason":"poweron","phases":{"app_main":41210,"can_listening":43890,
+//  ...,"first_page":null}}
+//
+// Handlers whose module may still be initialising when the server comes up
+// call boot_gate() first and answer 503 with Retry-After until it is ready.
+
+typedef enum {
+    BOOT_APP_MAIN,          // app_main entered
+    BOOT_CAN_LISTENING,     // driver started, RX and TX tasks running
+    BOOT_NVS,
+    BOOT_HTTPD,             // server up, all handlers registered
+    BOOT_WIFI,              // softAP started
+    BOOT_DIAG,              // sequences, job queue and calibration
+    BOOT_CAPTURE,           // capture log scanned (or found missing)
+    BOOT_FIRST_FRAME,       // first frame received
+    BOOT_FIRST_PAGE,        // first request for the page
+    BOOT_PHASE_COUNT,
+} boot_phase_t;
+
+#define BOOT_BIT(phase) ((EventBits_t)1 << (phase))
+
+// Creates the event group. First thing in app_main.
+esp_err_t boot_init(void);
+
+// Records the phase the first time it is reached; later calls do nothing.
+void boot_mark(boot_phase_t phase);
+bool boot_reached(boot_phase_t phase);
+
+// Blocks until all the phases in bits are reached. Returns false on timeout.
+bool boot_wait(EventBits_t bits, TickType_t timeout);
+
+// For handlers: returns true if all the phases in bits are reached,
+// otherwise answers 503 Service Unavailable and returns false. Never
+// blocks, since the server handles one request at a time.
+bool boot_gate(httpd_req_t *req, EventBits_t bits);
+
+esp_err_t boot_register(httpd_handle_t server);
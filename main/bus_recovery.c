@@ -0,0 +1,179 @@
+#include "bus_recovery.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "can_backend.h"
+#include "metrics.h"
+
+#define BUS_READY_BIT           (1 << 0)
+#define BUS_RECOVERY_POLL_MS    500     // fallback check for alerts the backend dropped
+#define ERR_WARN_LIMIT          96
+#define ERR_PASS_LIMIT          128
+
+#define LEVEL_ALERTS (CAN_ALERT_ERR_ACTIVE | CAN_ALERT_ABOVE_ERR_WARN | CAN_ALERT_BELOW_ERR_WARN | CAN_ALERT_ERR_PASS)
+
+static const char *TAG = "BUS_RECOVERY";
+
+static EventGroupHandle_t bus_events;
+static _Atomic int bus_state = BUS_STATE_ERROR_ACTIVE;
+static int64_t bus_off_us;
+
+static void set_state(bus_state_t state) {
+    bus_state_t old = atomic_exchange(&bus_state, state);
+    metrics_set(METRIC_BUS_STATE, state);
+    if (old != state) {
+        ESP_LOGI(TAG, "%s -> %s", bus_recovery_state_name(old), bus_recovery_state_name(state));
+    }
+}
+
+// Error level from the controller's counters, raised to what the alerts
+// say when the backend does not report counters.
+static bus_state_t error_level(uint32_t alerts) {
+    can_bus_status_t status;
+    uint32_t errors = 0;
+    if (can_backend_get_status(&status) == ESP_OK) {
+        errors = status.tx_error_counter > status.rx_error_counter ? status.tx_error_counter
+                                                                   : status.rx_error_counter;
+    }
+    bus_state_t level = errors >= ERR_PASS_LIMIT ? BUS_STATE_ERROR_PASSIVE
+                      : errors >= ERR_WARN_LIMIT ? BUS_STATE_ERROR_WARNING
+                      : BUS_STATE_ERROR_ACTIVE;
+    if (!(alerts & (CAN_ALERT_ERR_ACTIVE | CAN_ALERT_BELOW_ERR_WARN))) {
+        if ((alerts & CAN_ALERT_ERR_PASS) && level < BUS_STATE_ERROR_PASSIVE) {
+            level = BUS_STATE_ERROR_PASSIVE;
+        } else if ((alerts & CAN_ALERT_ABOVE_ERR_WARN) && level < BUS_STATE_ERROR_WARNING) {
+            level = BUS_STATE_ERROR_WARNING;
+        }
+    }
+    return level;
+}
+
+static void enter_bus_off(void) {
+    xEventGroupClearBits(bus_events, BUS_READY_BIT);
+    set_state(BUS_STATE_BUS_OFF);
+    metrics_inc(METRIC_BUS_OFF);
+    bus_off_us = esp_timer_get_time();
+
+    esp_err_t err = can_backend_initiate_recovery();
+    if (err == ESP_OK) {
+        set_state(BUS_STATE_RECOVERING);
+    } else {
+        ESP_LOGE(TAG, "Failed to initiate recovery: %s", esp_err_to_name(err));
+    }
+}
+
+// After recovery the controller is stopped; restarting it is all that is
+// left before frames can flow again.
+static void restart(void) {
+    esp_err_t err = can_backend_start();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to restart controller: %s", esp_err_to_name(err));
+        return;
+    }
+    metrics_inc(METRIC_RECOVERIES);
+    set_state(error_level(0));
+    xEventGroupSetBits(bus_events, BUS_READY_BIT);
+    ESP_LOGI(TAG, "Bus recovered after %" PRId64 " ms", (esp_timer_get_time() - bus_off_us) / 1000);
+}
+
+static void handle_alerts(uint32_t alerts) {
+    if (alerts & (CAN_ALERT_RX_QUEUE_FULL | CAN_ALERT_RX_OVERRUN)) {
+        metrics_inc(METRIC_RX_OVERRUNS);
+        ESP_LOGW(TAG, "Frames lost: %s", (alerts & CAN_ALERT_RX_OVERRUN) ? "controller FIFO overrun"
+                                                                        : "RX queue full");
+    }
+
+    bus_state_t state = atomic_load(&bus_state);
+    if (alerts & CAN_ALERT_BUS_OFF) {
+        if (state != BUS_STATE_BUS_OFF && state != BUS_STATE_RECOVERING) {
+            enter_bus_off();
+        }
+    } else if (alerts & CAN_ALERT_BUS_RECOVERED) {
+        restart();
+    } else if ((alerts & LEVEL_ALERTS) && state <= BUS_STATE_ERROR_PASSIVE) {
+        set_state(error_level(alerts));
+    }
+}
+
+// Catches up with the controller if an alert was missed.
+static void reconcile(void) {
+    can_bus_status_t status;
+    if (can_backend_get_status(&status) != ESP_OK) {
+        return;
+    }
+    bus_state_t state = atomic_load(&bus_state);
+    switch (status.state) {
+    case CAN_BUS_OFF:
+        // Also retries a recovery that failed to start
+        if (state != BUS_STATE_RECOVERING) {
+            enter_bus_off();
+        }
+        break;
+    case CAN_BUS_STOPPED:
+        restart();
+        break;
+    case CAN_BUS_RUNNING:
+        if (state == BUS_STATE_BUS_OFF || state == BUS_STATE_RECOVERING) {
+            restart();
+        } else {
+            set_state(error_level(0));
+        }
+        break;
+    case CAN_BUS_RECOVERING:
+        break;
+    }
+}
+
+static void bus_recovery_task(void *pvParameters) {
+    while (1) {
+        uint32_t alerts;
+        esp_err_t err = can_backend_read_alerts(&alerts, BUS_RECOVERY_POLL_MS);
+        if (err == ESP_OK) {
+            handle_alerts(alerts);
+        } else if (err == ESP_ERR_TIMEOUT) {
+            reconcile();
+        } else {
+            ESP_LOGE(TAG, "Failed to read alerts: %s", esp_err_to_name(err));
+            vTaskDelay(pdMS_TO_TICKS(BUS_RECOVERY_POLL_MS));
+        }
+    }
+}
+
+esp_err_t bus_recovery_start(UBaseType_t priority) {
+    bus_events = xEventGroupCreate();
+    if (bus_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    set_state(BUS_STATE_ERROR_ACTIVE);
+    xEventGroupSetBits(bus_events, BUS_READY_BIT);
+    if (xTaskCreate(bus_recovery_task, "bus_recovery", 3072, NULL, priority, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool bus_recovery_wait_ready(uint32_t timeout_ms) {
+    EventBits_t bits = xEventGroupWaitBits(bus_events, BUS_READY_BIT, pdFALSE, pdTRUE,
+                                           timeout_ms == CAN_BACKEND_WAIT_FOREVER ? portMAX_DELAY
+                                                                                 : pdMS_TO_TICKS(timeout_ms));
+    return (bits & BUS_READY_BIT) != 0;
+}
+
+bus_state_t bus_recovery_state(void) {
+    return atomic_load(&bus_state);
+}
+
+const char *bus_recovery_state_name(bus_state_t state) {
+    switch (state) {
+    case BUS_STATE_ERROR_ACTIVE:  return "error_active";
+    case BUS_STATE_ERROR_WARNING: return "error_warning";
+    case BUS_STATE_ERROR_PASSIVE: return "error_passive";
+    case BUS_STATE_BUS_OFF:       return "bus_off";
+    case BUS_STATE_RECOVERING:    return "recovering";
+    }
+    return "unknown";
+}
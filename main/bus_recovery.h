@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Bus error supervision. One task waits on the backend's alerts and is the
+// only place that reacts to controller errors: it tracks the error level,
+// starts bus-off recovery as soon as the controller goes bus-off and
+// restarts it the moment recovery completes. While the bus is unusable the
+// ready flag is cleared, so the TX task holds frames back instead of
+// failing them, and the RX task never has to handle recovery itself.
+
+typedef enum {
+    BUS_STATE_ERROR_ACTIVE,
+    BUS_STATE_ERROR_WARNING,    // an error counter reached 96
+    BUS_STATE_ERROR_PASSIVE,    // an error counter reached 128
+    BUS_STATE_BUS_OFF,
+    BUS_STATE_RECOVERING,       // waiting for 128 x 11 recessive bits
+} bus_state_t;
+
+// Call once the backend has been started.
+esp_err_t bus_recovery_start(UBaseType_t priority);
+
+// Blocks until the controller can transmit. Returns false on timeout.
+bool bus_recovery_wait_ready(uint32_t timeout_ms);
+
+bus_state_t bus_recovery_state(void);
+const char *bus_recovery_state_name(bus_state_t state);
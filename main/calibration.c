@@ -0,0 +1,396 @@
+#include "calibration.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "boot.h"
+#include "can_dispatch.h"
+#include "diag_jobs.h"
+#include "ecu_decode.h"
+#include "low_latency.h"
+#include "ws_push.h"
+
+#define STATE_JSON_SIZE 384
+
+static const char *TAG = "CALIBRATION";
+
+static const char *const phase_names[] = {
+    "idle", "end_stops", "centre", "configuring", "confirming", "done", "failed",
+};
+
+typedef struct {
+    calib_phase_t phase;
+    bool left;                  // negative end stop reached
+    bool right;                 // positive end stop reached
+    int32_t angle;              // hundredths of a degree, latest sample
+    int32_t left_angle;
+    int32_t right_angle;
+    int64_t start_us;
+    int64_t phase_us;           // current phase entered
+    int64_t end_us;
+    int64_t hold_since_us;      // wheel still in the target zone since, 0 if not
+    uint32_t job_id;
+    int status;                 // reported by status_check
+    char error[64];
+} calib_state_t;
+
+static calib_state_t state;
+static SemaphoreHandle_t state_lock;
+static esp_timer_handle_t tick_timer;
+static int event_source = -1;
+static int64_t last_push_us;
+
+static bool in_progress(calib_phase_t phase) {
+    return phase != CALIB_IDLE && phase != CALIB_DONE && phase != CALIB_FAILED;
+}
+
+// The helpers below are called with state_lock held.
+
+static void set_phase(calib_phase_t phase, int64_t now_us) {
+    state.phase = phase;
+    state.phase_us = now_us;
+    state.hold_since_us = 0;
+    if (!in_progress(phase)) {
+        state.end_us = now_us;
+    }
+    ESP_LOGI(TAG, "Phase %s after %" PRId64 " ms", phase_names[phase], (now_us - state.start_us) / 1000);
+}
+
+static void fail(int64_t now_us, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(state.error, sizeof(state.error), fmt, ap);
+    va_end(ap);
+    ESP_LOGW(TAG, "Calibration failed: %s", state.error);
+    set_phase(CALIB_FAILED, now_us);
+}
+
+static void submit(const char *sequence, calib_phase_t next, int64_t now_us) {
+    diag_job_t job;
+    esp_err_t err = diag_jobs_submit(sequence, &job);
+    if (err != ESP_OK) {
+        fail(now_us, "cannot queue %s: %s", sequence, esp_err_to_name(err));
+        return;
+    }
+    state.job_id = job.id;
+    set_phase(next, now_us);
+}
+
+static int32_t centre_angle(void) {
+    return (state.left_angle + state.right_angle) / 2;
+}
+
+static void track_wheel(const can_signal_sample_t *angle, const can_signal_sample_t *rate, int64_t now_us) {
+    if (angle->timestamp_us == 0 || now_us - angle->timestamp_us > CALIB_SIGNAL_TIMEOUT_MS * 1000LL) {
+        fail(now_us, "no steering angle frames");
+        return;
+    }
+    if (now_us - state.phase_us > CALIB_STEP_TIMEOUT_MS * 1000LL) {
+        fail(now_us, state.phase == CALIB_END_STOPS ? "timed out waiting for the end stops"
+                                                    : "timed out waiting for the centre");
+        return;
+    }
+    state.angle = angle->value;
+
+    // Zone the wheel is in: -1 and 1 for a missing end stop, 0 for the
+    // centre, none otherwise. The hold restarts whenever it leaves the zone
+    // or moves.
+    int zone = 2;
+    if (state.phase == CALIB_END_STOPS) {
+        if (!state.left && angle->value <= -CALIB_END_STOP_DEG * 100) {
+            zone = -1;
+        } else if (!state.right && angle->value >= CALIB_END_STOP_DEG * 100) {
+            zone = 1;
+        }
+    } else if (abs(angle->value - centre_angle()) <= CALIB_CENTRE_DEG * 100) {
+        zone = 0;
+    }
+    if (zone == 2 || abs(rate->value) >= CALIB_STILL_RATE_DEG_S * 100) {
+        state.hold_since_us = 0;
+        return;
+    }
+    if (state.hold_since_us == 0) {
+        state.hold_since_us = now_us;
+    }
+    int64_t held_ms = (now_us - state.hold_since_us) / 1000;
+
+    if (zone == 0) {
+        if (held_ms >= CALIB_CENTRE_HOLD_MS) {
+            submit("angle_config", CALIB_CONFIGURING, now_us);
+        }
+        return;
+    }
+    if (held_ms < CALIB_END_STOP_HOLD_MS) {
+        return;
+    }
+    if (zone < 0) {
+        state.left = true;
+        state.left_angle = angle->value;
+    } else {
+        state.right = true;
+        state.right_angle = angle->value;
+    }
+    state.hold_since_us = 0;
+    ESP_LOGI(TAG, "%s end stop at %" PRId32 " (1/100 deg)", zone < 0 ? "Left" : "Right", angle->value);
+    if (state.left && state.right) {
+        set_phase(CALIB_CENTRE, now_us);
+    }
+}
+
+static void track_job(int64_t now_us) {
+    diag_job_t job;
+    if (!diag_jobs_get(state.job_id, &job)) {
+        fail(now_us, "job %" PRIu32 " lost", state.job_id);
+        return;
+    }
+    if (job.state != DIAG_JOB_DONE) {
+        if (now_us - state.phase_us > CALIB_STEP_TIMEOUT_MS * 1000LL) {
+            // A job that has not started yet must not write the ECU later
+            diag_jobs_cancel(state.job_id);
+            fail(now_us, "timed out waiting for %s", job.sequence);
+        }
+        return;
+    }
+    if (state.phase == CALIB_CONFIGURING) {
+        if (job.result.nrc != 0) {
+            fail(now_us, "angle_config rejected, NRC 0x%02X", job.result.nrc);
+        } else if (!diag_jobs_succeeded(&job)) {
+            fail(now_us, "angle_config failed: %s", esp_err_to_name(job.result.err));
+        } else {
+            submit("status_check", CALIB_CONFIRMING, now_us);
+        }
+        return;
+    }
+
+    state.status = job.result.status;
+    if (!diag_jobs_succeeded(&job)) {
+        fail(now_us, "status_check failed: %s", esp_err_to_name(job.result.err));
+    } else if (job.result.status == 0) {
+        fail(now_us, "no status reply");
+    } else if (job.result.status != 4) {
+        fail(now_us, "ECU reports Status %d", job.result.status);
+    } else {
+        set_phase(CALIB_DONE, now_us);
+    }
+}
+
+// Stops following the procedure once it is over. Called exactly once per
+// calibration, by whoever moved it out of progress, before releasing
+// state_lock so a new calibration cannot start in between.
+static void finish(void) {
+    esp_timer_stop(tick_timer);
+    low_latency_release();
+}
+
+static void tick_callback(void *arg) {
+    int64_t now_us = esp_timer_get_time();
+    can_signal_sample_t angle, rate;
+    can_signal_get(ECU_SIGNAL_STEERING_ANGLE, &angle);
+    can_signal_get(ECU_SIGNAL_STEERING_RATE, &rate);
+
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    calib_phase_t before = state.phase;
+    switch (state.phase) {
+    case CALIB_END_STOPS:
+    case CALIB_CENTRE:
+        track_wheel(&angle, &rate, now_us);
+        break;
+    case CALIB_CONFIGURING:
+    case CALIB_CONFIRMING:
+        track_job(now_us);
+        break;
+    default:
+        break;
+    }
+    if (in_progress(before) && !in_progress(state.phase)) {
+        finish();
+    }
+    bool push = state.phase != before ||
+                ((state.phase == CALIB_END_STOPS || state.phase == CALIB_CENTRE) &&
+                 now_us - last_push_us >= CALIB_PUSH_MS * 1000LL);
+    xSemaphoreGive(state_lock);
+
+    if (push) {
+        last_push_us = now_us;
+        ws_push_event(event_source);
+    }
+}
+
+esp_err_t calibration_start(void) {
+    low_latency_acquire();
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    esp_err_t err = in_progress(state.phase) ? ESP_ERR_INVALID_STATE
+                                             : esp_timer_start_periodic(tick_timer, CALIB_TICK_MS * 1000);
+    if (err == ESP_OK) {
+        int64_t now_us = esp_timer_get_time();
+        memset(&state, 0, sizeof(state));
+        state.start_us = now_us;
+        set_phase(CALIB_END_STOPS, now_us);
+    }
+    xSemaphoreGive(state_lock);
+
+    if (err != ESP_OK) {
+        low_latency_release();
+        return err;
+    }
+    ws_push_event(event_source);
+    return ESP_OK;
+}
+
+esp_err_t calibration_cancel(void) {
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    bool cancelled = in_progress(state.phase);
+    if (cancelled && (state.phase == CALIB_CONFIGURING || state.phase == CALIB_CONFIRMING) &&
+        diag_jobs_cancel(state.job_id) == ESP_ERR_INVALID_STATE) {
+        // Already on the bus: the sequence cannot be stopped halfway
+        xSemaphoreGive(state_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (cancelled) {
+        fail(esp_timer_get_time(), "cancelled");
+        finish();
+    }
+    xSemaphoreGive(state_lock);
+    if (cancelled) {
+        ws_push_event(event_source);
+    }
+    return ESP_OK;
+}
+
+calib_phase_t calibration_phase(void) {
+    return state.phase;
+}
+
+// Hundredths of a degree as a JSON number in degrees
+static const char *degrees(char *buf, size_t cap, int32_t hundredths) {
+    uint32_t magnitude = (uint32_t)(hundredths < 0 ? -(int64_t)hundredths : hundredths);
+    snprintf(buf, cap, "%s%" PRIu32 ".%02" PRIu32, hundredths < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+    return buf;
+}
+
+static size_t state_json(char *buf, size_t cap) {
+    calib_state_t s;
+    xSemaphoreTake(state_lock, portMAX_DELAY);
+    s = state;
+    xSemaphoreGive(state_lock);
+
+    char angle[16], left[16] = "null", right[16] = "null", centre[16] = "null", error[80] = "null";
+    if (s.left) {
+        degrees(left, sizeof(left), s.left_angle);
+    }
+    if (s.right) {
+        degrees(right, sizeof(right), s.right_angle);
+    }
+    if (s.left && s.right) {
+        degrees(centre, sizeof(centre), (s.left_angle + s.right_angle) / 2);
+    }
+    if (s.phase == CALIB_FAILED) {
+        snprintf(error, sizeof(error), "\"%s\"", s.error);
+    }
+    int64_t elapsed_ms = s.phase == CALIB_IDLE ? 0
+                         : ((in_progress(s.phase) ? esp_timer_get_time() : s.end_us) - s.start_us) / 1000;
+
+    int n = snprintf(buf, cap,
+                     "{\"phase\":\"%s\",\"angle\":%s,\"left\":%s,\"right\":%s,\"left_angle\":%s,"
+                     "\"right_angle\":%s,\"centre_angle\":%s,\"elapsed_ms\":%" PRId64 ",\"job\":%" PRIu32
+                     ",\"status\":%d,\"error\":%s}",
+                     phase_names[s.phase], degrees(angle, sizeof(angle), s.angle), s.left ? "true" : "false",
+                     s.right ? "true" : "false", left, right, centre, elapsed_ms, s.job_id, s.status, error);
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+static size_t calibration_event_json(char *buf, size_t cap) {
+    static const char header[] = "{\"calibration\":";
+    if (cap < sizeof(header) + 2) {
+        return 0;
+    }
+    memcpy(buf, header, sizeof(header) - 1);
+    size_t len = sizeof(header) - 1;
+    size_t n = state_json(buf + len, cap - len - 1);
+    if (n == 0) {
+        return 0;
+    }
+    len += n;
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return len;
+}
+
+static esp_err_t send_state(httpd_req_t *req, const char *status) {
+    char response[STATE_JSON_SIZE];
+    size_t len = state_json(response, sizeof(response));
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, response, len);
+}
+
+static esp_err_t calibrate_post_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_DIAG))) {
+        return ESP_OK;
+    }
+    esp_err_t err = calibration_start();
+    if (err == ESP_ERR_INVALID_STATE) {
+        return send_state(req, "409 Conflict");
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start calibration");
+        return ESP_FAIL;
+    }
+    return send_state(req, "202 Accepted");
+}
+
+static esp_err_t calibrate_get_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_DIAG))) {
+        return ESP_OK;
+    }
+    return send_state(req, "200 OK");
+}
+
+static esp_err_t calibrate_delete_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_DIAG))) {
+        return ESP_OK;
+    }
+    if (calibration_cancel() == ESP_ERR_INVALID_STATE) {
+        return send_state(req, "409 Conflict");
+    }
+    return send_state(req, "200 OK");
+}
+
+esp_err_t calibration_init(void) {
+    state_lock = xSemaphoreCreateMutex();
+    if (state_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_timer_create_args_t args = {
+        .callback = &tick_callback,
+        .name = "calibration"
+    };
+    esp_err_t err = esp_timer_create(&args, &tick_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    event_source = ws_push_add_event_source(calibration_event_json);
+    return ESP_OK;
+}
+
+esp_err_t calibration_register(httpd_handle_t server) {
+    httpd_uri_t uris[] = {
+        {.uri = "/calibrate", .method = HTTP_POST,   .handler = calibrate_post_handler,   .user_ctx = NULL},
+        {.uri = "/calibrate", .method = HTTP_GET,    .handler = calibrate_get_handler,    .user_ctx = NULL},
+        {.uri = "/calibrate", .method = HTTP_DELETE, .handler = calibrate_delete_handler, .user_ctx = NULL},
+    };
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        esp_err_t err = httpd_register_uri_handler(server, &uris[i]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
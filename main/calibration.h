@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Closed-loop steering angle calibration. Instead of a fixed countdown the
+// procedure follows the live steering angle (ECU_SIGNAL_STEERING_ANGLE,
+// decoded from the 0x0C2 broadcast) and moves on as soon as the technician
+// has done each step:
+//
+//   end_stops    turn to both end stops, in either order. A stop counts
+//                once the wheel is held still beyond CALIB_END_STOP_DEG
+//                for CALIB_END_STOP_HOLD_MS.
+//   centre       return to the midpoint of the two stops (the sensor is
+//                not calibrated yet, so its zero cannot be trusted) and
+//                hold still for CALIB_CENTRE_HOLD_MS.
+//   configuring  angle_config runs as a diagnostic job.
+//   confirming   status_check runs; Status 4 on 0x762 means the ECU
+//                accepted the calibration.
+//   done | failed
+//
+// Every step times out after CALIB_STEP_TIMEOUT_MS, and the procedure
+// fails if the angle broadcast stops for CALIB_SIGNAL_TIMEOUT_MS. Low-
+// latency mode is held from start to finish.
+//
+//   POST   /calibrate      start (409 if one is already in progress)
+//   GET    /calibrate      current state
+//   DELETE /calibrate      cancel, withdrawing a queued job (409 while
+//                          angle_config or status_check is running)
+//
+// The state, including the live angle while the wheel is being turned, is
+// pushed to WebSocket clients as {"calibration":{...}}:
+//
+// {"calibration":{"phase":"centre","angle":-12.34,"left":true,"right":true,
+//  "left_angle":-512.06,"right_angle":508.19,"centre_angle":-1.93,
+//  "elapsed_ms":8400,"job":0,"status":0,"error":null}}
+
+#ifndef CALIB_END_STOP_DEG
+#define CALIB_END_STOP_DEG      400     // |angle| beyond this may be an end stop
+#endif
+#define CALIB_STILL_RATE_DEG_S  20      // "held still" below this steering rate
+#define CALIB_END_STOP_HOLD_MS  300
+#define CALIB_CENTRE_DEG        5       // tolerance around the midpoint
+#define CALIB_CENTRE_HOLD_MS    1000
+#define CALIB_STEP_TIMEOUT_MS   60000
+#define CALIB_SIGNAL_TIMEOUT_MS 500
+#define CALIB_TICK_MS           20
+#define CALIB_PUSH_MS           100     // live angle updates to WebSocket clients
+
+typedef enum {
+    CALIB_IDLE,
+    CALIB_END_STOPS,
+    CALIB_CENTRE,
+    CALIB_CONFIGURING,
+    CALIB_CONFIRMING,
+    CALIB_DONE,
+    CALIB_FAILED,
+} calib_phase_t;
+
+// Creates the timer and the WebSocket event source. May run before or
+// after ws_push_start(): at boot net_init_task starts the web server and
+// ws_push concurrently with this, and ws_push_add_event_source() accepts
+// sources added late, sending them to clients already connected.
+esp_err_t calibration_init(void);
+
+// Returns ESP_ERR_INVALID_STATE if a calibration is in progress.
+esp_err_t calibration_start(void);
+
+// Returns ESP_ERR_INVALID_STATE, and leaves the calibration running, if its
+// diagnostic job is already on the bus.
+esp_err_t calibration_cancel(void);
+
+calib_phase_t calibration_phase(void);
+
+esp_err_t calibration_register(httpd_handle_t server);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "can_filter.h"
+
+// Bus access used by the rest of the firmware. Exactly one backend is
+// linked in, chosen by main/CMakeLists.txt:
+//
+//   can_backend_twai.c       ESP32-C3 TWAI controller
+//   can_backend_socketcan.c  Linux SocketCAN (e.g. vcan0), for the ESP-IDF
+//                            linux target and host tools
+//
+// Calls follow the TWAI driver's model: install once, start/stop, blocking
+// transmit and receive with a timeout, alerts for error state changes and
+// explicit bus-off recovery.
+
+#define CAN_BACKEND_WAIT_FOREVER UINT32_MAX
+
+#define CAN_FRAME_EXTD  0x01    // 29-bit identifier
+#define CAN_FRAME_RTR   0x02    // remote frame
+
+typedef struct {
+    uint32_t identifier;
+    uint8_t flags;
+    uint8_t dlc;
+    uint8_t data[8];
+} can_frame_t;
+
+// Controller alerts, reported by can_backend_read_alerts()
+#define CAN_ALERT_ERR_ACTIVE        0x0001  // back to error active
+#define CAN_ALERT_ABOVE_ERR_WARN    0x0002  // an error counter reached 96
+#define CAN_ALERT_BELOW_ERR_WARN    0x0004
+#define CAN_ALERT_ERR_PASS          0x0008  // an error counter reached 128
+#define CAN_ALERT_BUS_OFF           0x0010
+#define CAN_ALERT_BUS_RECOVERED     0x0020  // recovery done, controller stopped
+#define CAN_ALERT_RX_QUEUE_FULL     0x0040  // driver queue full, frame dropped
+#define CAN_ALERT_RX_OVERRUN        0x0080  // controller FIFO overrun
+
+typedef enum {
+    CAN_BUS_STOPPED,
+    CAN_BUS_RUNNING,
+    CAN_BUS_OFF,
+    CAN_BUS_RECOVERING,
+} can_bus_state_t;
+
+typedef struct {
+    can_bus_state_t state;
+    uint32_t tx_pending;
+    uint32_t rx_pending;
+    uint32_t tx_error_counter;
+    uint32_t rx_error_counter;
+} can_bus_status_t;
+
+typedef struct {
+    int tx_gpio;                    // TWAI pins
+    int rx_gpio;
+    const char *ifname;             // SocketCAN interface
+    uint32_t rx_queue_len;          // driver RX queue depth, where configurable
+    const can_rx_rule_t *rules;     // frames to accept; NULL accepts everything
+    size_t rule_count;
+} can_backend_config_t;
+
+// Installs the backend and programs the acceptance filter for cfg->rules.
+// filter (may be NULL) receives what the hardware ended up accepting; when
+// it is not exact the caller must re-check frames with can_filter_match().
+esp_err_t can_backend_install(const can_backend_config_t *cfg, can_hw_filter_t *filter);
+
+esp_err_t can_backend_start(void);
+esp_err_t can_backend_stop(void);
+
+esp_err_t can_backend_transmit(const can_frame_t *frame, uint32_t timeout_ms);
+
+// Returns ESP_ERR_TIMEOUT if nothing arrived within timeout_ms.
+esp_err_t can_backend_receive(can_frame_t *frame, uint32_t timeout_ms);
+
+esp_err_t can_backend_get_status(can_bus_status_t *status);
+esp_err_t can_backend_initiate_recovery(void);
+
+// Waits for controller alerts and returns the CAN_ALERT_* bits raised since
+// the previous call. Returns ESP_ERR_TIMEOUT if none arrived in timeout_ms.
+esp_err_t can_backend_read_alerts(uint32_t *alerts, uint32_t timeout_ms);
@@ -0,0 +1,281 @@
+#include "can_backend.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+
+// SocketCAN backend. Bitrate and automatic bus-off restart belong to the
+// interface (`ip link set can0 type can bitrate 500000 restart-ms 100`);
+// vcan needs neither. Uses only POSIX calls so host tools can link it
+// without FreeRTOS.
+
+static int can_fd = -1;
+static atomic_bool running;
+static atomic_int bus_state = CAN_BUS_STOPPED;
+static atomic_uint tx_errors, rx_errors;
+
+// Alerts are raised by the receive path, which sees the kernel's error
+// frames, and handed to can_backend_read_alerts() through an eventfd.
+static int alert_fd = -1;
+static atomic_uint pending_alerts;
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void raise_alerts(uint32_t alerts) {
+    if (alerts != 0) {
+        atomic_fetch_or(&pending_alerts, alerts);
+        uint64_t one = 1;
+        (void)write(alert_fd, &one, sizeof(one));
+    }
+}
+
+// Milliseconds left until deadline, in poll() terms (-1 waits forever).
+static int poll_timeout(int64_t deadline_ms) {
+    if (deadline_ms < 0) {
+        return -1;
+    }
+    int64_t left = deadline_ms - now_ms();
+    return left > 0 ? (int)left : 0;
+}
+
+esp_err_t can_backend_install(const can_backend_config_t *cfg, can_hw_filter_t *filter) {
+    if (can_fd >= 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (fd < 0) {
+        return ESP_FAIL;
+    }
+
+    struct ifreq ifr = {0};
+    strncpy(ifr.ifr_name, cfg->ifname != NULL ? cfg->ifname : "vcan0", sizeof(ifr.ifr_name) - 1);
+    struct sockaddr_can addr = {.can_family = AF_CAN};
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+        close(fd);
+        return ESP_ERR_NOT_FOUND;
+    }
+    addr.can_ifindex = ifr.ifr_ifindex;
+
+    // The kernel filters on identifiers only, so rules with a payload
+    // prefix still need the software check. Like can_filter_compute(), more
+    // rules than CAN_FILTER_MAX_RULES open the filter and leave the whole
+    // match to software.
+    can_hw_filter_t hw = {.exact = cfg->rules != NULL, .ids_accepted = 2048};
+    if (cfg->rules != NULL && cfg->rule_count > CAN_FILTER_MAX_RULES) {
+        fprintf(stderr, "can_backend: %zu rules exceed the %d the filter holds, accepting all frames\n",
+                cfg->rule_count, CAN_FILTER_MAX_RULES);
+        hw.exact = false;
+    } else if (cfg->rules != NULL) {
+        struct can_filter kf[CAN_FILTER_MAX_RULES];
+        size_t n = cfg->rule_count;
+        hw.ids_accepted = 0;
+        for (size_t i = 0; i < n; i++) {
+            kf[i].can_id = cfg->rules[i].identifier & CAN_SFF_MASK;
+            kf[i].can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+            if (cfg->rules[i].prefix_len > 0) {
+                hw.exact = false;
+            }
+            bool seen = false;
+            for (size_t j = 0; j < i; j++) {
+                seen |= kf[j].can_id == kf[i].can_id;
+            }
+            hw.ids_accepted += seen ? 0 : 1;
+        }
+        if (setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, kf, n * sizeof(kf[0])) < 0) {
+            close(fd);
+            return ESP_FAIL;
+        }
+    }
+    can_err_mask_t err_mask = CAN_ERR_BUSOFF | CAN_ERR_RESTARTED | CAN_ERR_CRTL;
+    setsockopt(fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask));
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return ESP_FAIL;
+    }
+    alert_fd = eventfd(0, EFD_NONBLOCK);
+    if (alert_fd < 0) {
+        close(fd);
+        return ESP_FAIL;
+    }
+    if (filter != NULL) {
+        *filter = hw;
+    }
+    can_fd = fd;
+    return ESP_OK;
+}
+
+esp_err_t can_backend_start(void) {
+    if (can_fd < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    atomic_store(&running, true);
+    atomic_store(&bus_state, CAN_BUS_RUNNING);
+    return ESP_OK;
+}
+
+esp_err_t can_backend_stop(void) {
+    if (!atomic_exchange(&running, false)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    atomic_store(&bus_state, CAN_BUS_STOPPED);
+    return ESP_OK;
+}
+
+esp_err_t can_backend_transmit(const can_frame_t *frame, uint32_t timeout_ms) {
+    if (!atomic_load(&running) || atomic_load(&bus_state) != CAN_BUS_RUNNING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    struct can_frame cf = {0};
+    cf.can_id = frame->identifier & ((frame->flags & CAN_FRAME_EXTD) ? CAN_EFF_MASK : CAN_SFF_MASK);
+    cf.can_id |= ((frame->flags & CAN_FRAME_EXTD) ? CAN_EFF_FLAG : 0) | ((frame->flags & CAN_FRAME_RTR) ? CAN_RTR_FLAG : 0);
+    cf.can_dlc = frame->dlc > 8 ? 8 : frame->dlc;
+    memcpy(cf.data, frame->data, sizeof(cf.data));
+
+    int64_t deadline = timeout_ms == CAN_BACKEND_WAIT_FOREVER ? -1 : now_ms() + timeout_ms;
+    while (1) {
+        if (write(can_fd, &cf, sizeof(cf)) == sizeof(cf)) {
+            return ESP_OK;
+        }
+        if (errno != ENOBUFS && errno != EAGAIN && errno != EINTR) {
+            return ESP_FAIL;
+        }
+        // The interface queue is full: wait for room, like twai_transmit()
+        // waiting on its TX queue.
+        struct pollfd pfd = {.fd = can_fd, .events = POLLOUT};
+        int wait = poll_timeout(deadline);
+        if (wait == 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        poll(&pfd, 1, wait < 0 || wait > 10 ? 10 : wait);
+    }
+}
+
+static void handle_error_frame(const struct can_frame *cf) {
+    uint32_t alerts = 0;
+    if (cf->can_id & CAN_ERR_CNT) {
+        atomic_store(&tx_errors, cf->data[6]);
+        atomic_store(&rx_errors, cf->data[7]);
+    }
+    if (cf->can_id & CAN_ERR_CRTL) {
+        uint8_t crtl = cf->data[1];
+        if (crtl & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) {
+            alerts |= CAN_ALERT_ERR_PASS;
+        } else if (crtl & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) {
+            alerts |= CAN_ALERT_ABOVE_ERR_WARN;
+        }
+        if (crtl & CAN_ERR_CRTL_ACTIVE) {
+            alerts |= CAN_ALERT_ERR_ACTIVE;
+        }
+        if (crtl & CAN_ERR_CRTL_RX_OVERFLOW) {
+            alerts |= CAN_ALERT_RX_OVERRUN;
+        }
+    }
+    if (cf->can_id & CAN_ERR_BUSOFF) {
+        atomic_store(&bus_state, CAN_BUS_OFF);
+        alerts |= CAN_ALERT_BUS_OFF;
+    } else if (cf->can_id & CAN_ERR_RESTARTED) {
+        // The kernel restarts the controller itself (restart-ms)
+        atomic_store(&bus_state, CAN_BUS_RUNNING);
+        atomic_store(&tx_errors, 0);
+        atomic_store(&rx_errors, 0);
+        alerts |= CAN_ALERT_BUS_RECOVERED;
+    }
+    raise_alerts(alerts);
+}
+
+esp_err_t can_backend_receive(can_frame_t *frame, uint32_t timeout_ms) {
+    int64_t deadline = timeout_ms == CAN_BACKEND_WAIT_FOREVER ? -1 : now_ms() + timeout_ms;
+    while (1) {
+        if (!atomic_load(&running)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        struct pollfd pfd = {.fd = can_fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, poll_timeout(deadline));
+        if (ready == 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ESP_FAIL;
+        }
+
+        struct can_frame cf;
+        if (read(can_fd, &cf, sizeof(cf)) != sizeof(cf)) {
+            return ESP_FAIL;
+        }
+        if (cf.can_id & CAN_ERR_FLAG) {
+            handle_error_frame(&cf);
+            continue;
+        }
+
+        bool extd = cf.can_id & CAN_EFF_FLAG;
+        frame->identifier = cf.can_id & (extd ? CAN_EFF_MASK : CAN_SFF_MASK);
+        frame->flags = (extd ? CAN_FRAME_EXTD : 0) | ((cf.can_id & CAN_RTR_FLAG) ? CAN_FRAME_RTR : 0);
+        frame->dlc = cf.can_dlc > 8 ? 8 : cf.can_dlc;
+        memcpy(frame->data, cf.data, sizeof(frame->data));
+        return ESP_OK;
+    }
+}
+
+esp_err_t can_backend_get_status(can_bus_status_t *status) {
+    if (can_fd < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(status, 0, sizeof(*status));
+    status->state = atomic_load(&bus_state);
+    status->tx_error_counter = atomic_load(&tx_errors);
+    status->rx_error_counter = atomic_load(&rx_errors);
+    return ESP_OK;
+}
+
+esp_err_t can_backend_initiate_recovery(void) {
+    // The kernel restarts the controller after restart-ms; report it as
+    // recovering until the CAN_ERR_RESTARTED frame arrives.
+    if (atomic_load(&bus_state) != CAN_BUS_OFF) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    atomic_store(&bus_state, CAN_BUS_RECOVERING);
+    return ESP_OK;
+}
+
+esp_err_t can_backend_read_alerts(uint32_t *alerts, uint32_t timeout_ms) {
+    if (alert_fd < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t deadline = timeout_ms == CAN_BACKEND_WAIT_FOREVER ? -1 : now_ms() + timeout_ms;
+    while (1) {
+        uint32_t raised = atomic_exchange(&pending_alerts, 0);
+        if (raised != 0) {
+            *alerts = raised;
+            return ESP_OK;
+        }
+        struct pollfd pfd = {.fd = alert_fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, poll_timeout(deadline));
+        if (ready == 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return ESP_FAIL;
+        }
+        uint64_t count;
+        (void)read(alert_fd, &count, sizeof(count));
+    }
+}
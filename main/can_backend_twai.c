@@ -0,0 +1,133 @@
+#include "can_backend.h"
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_intr_alloc.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/twai.h"
+
+static const struct {
+    uint32_t twai;
+    uint32_t can;
+} alert_map[] = {
+    {TWAI_ALERT_ERR_ACTIVE,      CAN_ALERT_ERR_ACTIVE},
+    {TWAI_ALERT_ABOVE_ERR_WARN,  CAN_ALERT_ABOVE_ERR_WARN},
+    {TWAI_ALERT_BELOW_ERR_WARN,  CAN_ALERT_BELOW_ERR_WARN},
+    {TWAI_ALERT_ERR_PASS,        CAN_ALERT_ERR_PASS},
+    {TWAI_ALERT_BUS_OFF,         CAN_ALERT_BUS_OFF},
+    {TWAI_ALERT_BUS_RECOVERED,   CAN_ALERT_BUS_RECOVERED},
+    {TWAI_ALERT_RX_QUEUE_FULL,   CAN_ALERT_RX_QUEUE_FULL},
+    {TWAI_ALERT_RX_FIFO_OVERRUN, CAN_ALERT_RX_OVERRUN},
+};
+#define ALERT_COUNT (sizeof(alert_map) / sizeof(alert_map[0]))
+
+static TickType_t to_ticks(uint32_t timeout_ms) {
+    return timeout_ms == CAN_BACKEND_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+}
+
+esp_err_t can_backend_install(const can_backend_config_t *cfg, can_hw_filter_t *filter) {
+    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(cfg->tx_gpio, cfg->rx_gpio, TWAI_MODE_NORMAL);
+    if (cfg->rx_queue_len > 0) {
+        g_config.rx_queue_len = cfg->rx_queue_len;
+    }
+#if CONFIG_TWAI_ISR_IN_IRAM
+    // Keeps the interrupt enabled while the flash cache is off (capture
+    // sector erases), so the driver queue goes on filling.
+    g_config.intr_flags |= ESP_INTR_FLAG_IRAM;
+#endif
+    g_config.alerts_enabled = 0;
+    for (size_t i = 0; i < ALERT_COUNT; i++) {
+        g_config.alerts_enabled |= alert_map[i].twai;
+    }
+    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
+
+    can_hw_filter_t hw = {
+        .acceptance_code = 0,
+        .acceptance_mask = 0xFFFFFFFF,
+        .single_filter = true,
+        .exact = false,
+        .ids_accepted = 2048,
+    };
+    if (cfg->rules != NULL) {
+        can_filter_compute(cfg->rules, cfg->rule_count, &hw);
+    }
+    twai_filter_config_t f_config = {
+        .acceptance_code = hw.acceptance_code,
+        .acceptance_mask = hw.acceptance_mask,
+        .single_filter = hw.single_filter,
+    };
+    if (filter != NULL) {
+        *filter = hw;
+    }
+    return twai_driver_install(&g_config, &t_config, &f_config);
+}
+
+esp_err_t can_backend_start(void) {
+    return twai_start();
+}
+
+esp_err_t can_backend_stop(void) {
+    return twai_stop();
+}
+
+esp_err_t can_backend_transmit(const can_frame_t *frame, uint32_t timeout_ms) {
+    twai_message_t message = {
+        .extd = (frame->flags & CAN_FRAME_EXTD) ? 1 : 0,
+        .rtr = (frame->flags & CAN_FRAME_RTR) ? 1 : 0,
+        .identifier = frame->identifier,
+        .data_length_code = frame->dlc,
+    };
+    memcpy(message.data, frame->data, sizeof(message.data));
+    return twai_transmit(&message, to_ticks(timeout_ms));
+}
+
+esp_err_t can_backend_receive(can_frame_t *frame, uint32_t timeout_ms) {
+    twai_message_t message;
+    esp_err_t err = twai_receive(&message, to_ticks(timeout_ms));
+    if (err != ESP_OK) {
+        return err;
+    }
+    frame->identifier = message.identifier;
+    frame->flags = (message.extd ? CAN_FRAME_EXTD : 0) | (message.rtr ? CAN_FRAME_RTR : 0);
+    frame->dlc = message.data_length_code > 8 ? 8 : message.data_length_code;
+    memcpy(frame->data, message.data, sizeof(frame->data));
+    return ESP_OK;
+}
+
+esp_err_t can_backend_get_status(can_bus_status_t *status) {
+    twai_status_info_t info;
+    esp_err_t err = twai_get_status_info(&info);
+    if (err != ESP_OK) {
+        return err;
+    }
+    switch (info.state) {
+    case TWAI_STATE_RUNNING:    status->state = CAN_BUS_RUNNING; break;
+    case TWAI_STATE_BUS_OFF:    status->state = CAN_BUS_OFF; break;
+    case TWAI_STATE_RECOVERING: status->state = CAN_BUS_RECOVERING; break;
+    default:                    status->state = CAN_BUS_STOPPED; break;
+    }
+    status->tx_pending = info.msgs_to_tx;
+    status->rx_pending = info.msgs_to_rx;
+    status->tx_error_counter = info.tx_error_counter;
+    status->rx_error_counter = info.rx_error_counter;
+    return ESP_OK;
+}
+
+esp_err_t can_backend_initiate_recovery(void) {
+    return twai_initiate_recovery();
+}
+
+esp_err_t can_backend_read_alerts(uint32_t *alerts, uint32_t timeout_ms) {
+    uint32_t raised;
+    esp_err_t err = twai_read_alerts(&raised, to_ticks(timeout_ms));
+    if (err != ESP_OK) {
+        return err;
+    }
+    *alerts = 0;
+    for (size_t i = 0; i < ALERT_COUNT; i++) {
+        if (raised & alert_map[i].twai) {
+            *alerts |= alert_map[i].can;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,254 @@
+#include "can_dispatch.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "low_latency.h"
+
+#define STD_ID_MASK         0x7FFu
+#define NO_HANDLER          0xFF
+#define SIGNAL_NAME_MAX     24
+#define SIGNALS_BUF_SIZE    1536
+
+static const char *TAG = "CAN_DISPATCH";
+
+_Static_assert(CAN_DISPATCH_ID_COUNT == STD_ID_MASK + 1, "table covers the 11-bit ID space");
+_Static_assert(CAN_DISPATCH_MAX_HANDLERS < NO_HANDLER, "handler indices fit in a byte");
+
+// First handler for each identifier and the next one for the same ID
+static uint8_t id_first[CAN_DISPATCH_ID_COUNT];
+static uint8_t handler_next[CAN_DISPATCH_MAX_HANDLERS];
+static const can_handler_t *handlers;
+
+static can_rx_rule_t rules[CAN_DISPATCH_MAX_HANDLERS];
+static size_t rule_count;
+
+// Seqlock per slot: odd while the RX task is writing it
+typedef struct {
+    _Atomic uint32_t version;
+    int32_t value;
+    int64_t timestamp_us;
+    uint32_t updates;
+} signal_slot_t;
+
+typedef struct {
+    char name[SIGNAL_NAME_MAX];
+    const char *unit;
+    int32_t scale_div;
+} signal_info_t;
+
+static signal_slot_t signals[CAN_DISPATCH_MAX_SIGNALS];
+static signal_info_t signal_info[CAN_DISPATCH_MAX_SIGNALS];
+static _Atomic int signal_count;
+
+// Adds a rule for the handler's ID, or narrows the existing one to the
+// prefix all handlers of that ID have in common.
+static void add_rule(const can_handler_t *h) {
+    for (size_t i = 0; i < rule_count; i++) {
+        can_rx_rule_t *r = &rules[i];
+        if (r->identifier != h->identifier) {
+            continue;
+        }
+        uint8_t n = 0;
+        while (n < r->prefix_len && n < h->prefix_len && r->prefix[n] == h->prefix[n]) {
+            n++;
+        }
+        r->prefix_len = n;
+        return;
+    }
+    can_rx_rule_t *r = &rules[rule_count++];
+    r->identifier = h->identifier;
+    memcpy(r->prefix, h->prefix, h->prefix_len);
+    r->prefix_len = h->prefix_len;
+}
+
+esp_err_t can_dispatch_init(const can_handler_t *table, size_t count) {
+    if (count > CAN_DISPATCH_MAX_HANDLERS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(id_first, NO_HANDLER, sizeof(id_first));
+    rule_count = 0;
+
+    // Built back to front so each ID's chain keeps table order
+    for (size_t i = count; i-- > 0;) {
+        const can_handler_t *h = &table[i];
+        if (h->identifier > STD_ID_MASK || h->prefix_len > CAN_FILTER_MAX_PREFIX) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        handler_next[i] = id_first[h->identifier];
+        id_first[h->identifier] = (uint8_t)i;
+    }
+    for (size_t i = 0; i < count; i++) {
+        add_rule(&table[i]);
+    }
+    handlers = table;
+    ESP_LOGI(TAG, "%u handlers on %u IDs", (unsigned)count, (unsigned)rule_count);
+    return ESP_OK;
+}
+
+LOW_LATENCY_IRAM int can_dispatch_frame(can_record_t *rec) {
+    uint8_t i = id_first[rec->identifier & STD_ID_MASK];
+    int flags = -1;
+    while (i != NO_HANDLER) {
+        const can_handler_t *h = &handlers[i];
+        if (rec->dlc >= h->prefix_len && memcmp(rec->data, h->prefix, h->prefix_len) == 0) {
+            if (h->decode != NULL) {
+                h->decode(rec, h->ctx);
+            }
+            flags = (flags < 0 ? 0 : flags) | h->flags;
+        }
+        i = handler_next[i];
+    }
+    return flags;
+}
+
+const can_rx_rule_t *can_dispatch_rules(size_t *count) {
+    *count = rule_count;
+    return rules;
+}
+
+bool can_dispatch_accepts(uint32_t identifier, const uint8_t *prefix, uint8_t prefix_len) {
+    if (identifier > STD_ID_MASK) {
+        return false;
+    }
+    for (uint8_t i = id_first[identifier]; i != NO_HANDLER; i = handler_next[i]) {
+        const can_handler_t *h = &handlers[i];
+        uint8_t n = h->prefix_len < prefix_len ? h->prefix_len : prefix_len;
+        if (memcmp(h->prefix, prefix, n) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int can_signal_define(const char *name, const char *unit, int32_t scale_div) {
+    int i = atomic_load(&signal_count);
+    if (i >= CAN_DISPATCH_MAX_SIGNALS) {
+        ESP_LOGW(TAG, "No room for signal %s", name);
+        return -1;
+    }
+    snprintf(signal_info[i].name, sizeof(signal_info[i].name), "%s", name);
+    signal_info[i].unit = unit;
+    signal_info[i].scale_div = scale_div > 0 ? scale_div : 1;
+    atomic_store(&signal_count, i + 1);
+    return i;
+}
+
+LOW_LATENCY_IRAM void can_signal_set(int signal, int32_t value, int64_t timestamp_us) {
+    if (signal < 0 || signal >= CAN_DISPATCH_MAX_SIGNALS) {
+        return;
+    }
+    signal_slot_t *s = &signals[signal];
+    uint32_t v = atomic_load_explicit(&s->version, memory_order_relaxed);
+    atomic_store_explicit(&s->version, v + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s->value = value;
+    s->timestamp_us = timestamp_us;
+    s->updates++;
+    atomic_store_explicit(&s->version, v + 2, memory_order_release);
+}
+
+bool can_signal_get(int signal, can_signal_sample_t *out) {
+    if (signal < 0 || signal >= atomic_load(&signal_count)) {
+        return false;
+    }
+    const signal_slot_t *s = &signals[signal];
+    uint32_t before, after;
+    do {
+        before = atomic_load_explicit(&s->version, memory_order_acquire);
+        out->value = s->value;
+        out->timestamp_us = s->timestamp_us;
+        out->updates = s->updates;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&s->version, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return true;
+}
+
+int can_signal_find(const char *name) {
+    int n = atomic_load(&signal_count);
+    for (int i = 0; i < n; i++) {
+        if (strcmp(signal_info[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// {"name":"steering_angle","value":-12.35,"unit":"deg","t":1234567,"updates":42}
+static int signal_json(char *buf, size_t cap, int signal) {
+    const signal_info_t *info = &signal_info[signal];
+    can_signal_sample_t s;
+    if (!can_signal_get(signal, &s)) {
+        s = (can_signal_sample_t){0};   // reported as never set
+    }
+
+    // Longest value: "-", 10 integer digits, "." and 9 decimals
+    char value[24];
+    if (info->scale_div == 1) {
+        snprintf(value, sizeof(value), "%" PRId32, s.value);
+    } else {
+        int digits = 0;
+        for (int32_t d = info->scale_div; d > 1 && digits < 9; d /= 10) {
+            digits++;
+        }
+        uint32_t mag = s.value < 0 ? 0u - (uint32_t)s.value : (uint32_t)s.value;
+        snprintf(value, sizeof(value), "%s%" PRIu32 ".%0*" PRIu32, s.value < 0 ? "-" : "",
+                 mag / (uint32_t)info->scale_div, digits, mag % (uint32_t)info->scale_div);
+    }
+    return snprintf(buf, cap, "{\"name\":\"%s\",\"value\":%s,\"unit\":\"%s\",\"t\":%" PRId64 ",\"updates\":%" PRIu32 "}",
+                    info->name, s.timestamp_us != 0 ? value : "null", info->unit, s.timestamp_us, s.updates);
+}
+
+static esp_err_t signals_handler(httpd_req_t *req) {
+    char query[48], name[SIGNAL_NAME_MAX];
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "name", name, sizeof(name)) == ESP_OK) {
+        int signal = can_signal_find(name);
+        if (signal < 0) {
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown signal");
+            return ESP_FAIL;
+        }
+        char response[160];
+        int n = signal_json(response, sizeof(response), signal);
+        return httpd_resp_send(req, response, n);
+    }
+
+    char *response = malloc(SIGNALS_BUF_SIZE);
+    if (response == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    size_t len = (size_t)snprintf(response, SIGNALS_BUF_SIZE, "{\"signals\":[");
+    int count = atomic_load(&signal_count);
+    for (int i = 0; i < count; i++) {
+        int n = signal_json(response + len + (i > 0), SIGNALS_BUF_SIZE - len - (i > 0) - 2, i);
+        if (n < 0 || (size_t)n >= SIGNALS_BUF_SIZE - len - (i > 0) - 2) {
+            break;
+        }
+        if (i > 0) {
+            response[len++] = ',';
+        }
+        len += n;
+    }
+    response[len++] = ']';
+    response[len++] = '}';
+    esp_err_t err = httpd_resp_send(req, response, len);
+    free(response);
+    return err;
+}
+
+esp_err_t can_dispatch_register(httpd_handle_t server) {
+    httpd_uri_t uri_signals = {
+        .uri       = "/signals",
+        .method    = HTTP_GET,
+        .handler   = signals_handler,
+        .user_ctx  = NULL
+    };
+    return httpd_register_uri_handler(server, &uri_signals);
+}
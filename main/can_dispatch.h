@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "can_filter.h"
+#include "rx_ring.h"
+
+// Per-identifier dispatch of received frames. A 2048-entry table indexed by
+// the 11-bit identifier points at the handlers for that ID, so the RX task
+// finds them with one load however many IDs are monitored; frames with no
+// handler are dropped right there.
+//
+// Each handler has an optional payload prefix and a decoder. Decoders run in
+// the RX task and publish what they extract to the signal cache: one slot
+// per signal holding the latest value and its timestamp, read by HTTP
+// handlers in O(1) without locks.
+//
+//   GET /signals               every signal as JSON
+//   GET /signals?name=<n>      one signal
+
+#define CAN_DISPATCH_MAX_HANDLERS   64
+#define CAN_DISPATCH_MAX_SIGNALS    32
+#define CAN_DISPATCH_ID_COUNT       2048
+
+// Handler flags
+#define CAN_DISPATCH_STORE  0x01    // keep the frame in the RX ring and offer it to
+                                    // ISO-TP and the WebSocket push. Every
+                                    // dispatched frame is offered to resp_match.
+
+// Called from the RX task for every frame the handler matches. May set
+// rec->status before the frame is stored.
+typedef void (*can_decoder_t)(can_record_t *rec, void *ctx);
+
+typedef struct {
+    uint16_t identifier;
+    uint8_t prefix[CAN_FILTER_MAX_PREFIX];
+    uint8_t prefix_len;
+    uint8_t flags;
+    can_decoder_t decode;   // may be NULL
+    void *ctx;
+} can_handler_t;
+
+typedef struct {
+    int32_t value;
+    int64_t timestamp_us;   // 0 if never set
+    uint32_t updates;
+} can_signal_sample_t;
+
+// Builds the ID table from handlers, which must stay valid. Call once
+// before the RX task starts; the table is read-only afterwards.
+esp_err_t can_dispatch_init(const can_handler_t *handlers, size_t count);
+
+// Runs every handler registered for rec->identifier whose prefix matches.
+// Returns the OR of their flags, or -1 if none matched.
+int can_dispatch_frame(can_record_t *rec);
+
+// Acceptance rules covering every handler, for can_backend_config_t.
+const can_rx_rule_t *can_dispatch_rules(size_t *count);
+
+// True if a frame with this identifier and payload prefix can reach the RX
+// task: some handler for the ID has a prefix compatible with it.
+bool can_dispatch_accepts(uint32_t identifier, const uint8_t *prefix, uint8_t prefix_len);
+
+// Declares a signal and returns its index, or -1 if the cache is full.
+// scale_div turns the stored integer into the unit shown over HTTP
+// (value / scale_div), e.g. 100 for hundredths of a degree.
+int can_signal_define(const char *name, const char *unit, int32_t scale_div);
+
+// Single writer per signal (a decoder in the RX task).
+void can_signal_set(int signal, int32_t value, int64_t timestamp_us);
+
+// Latest sample, consistent even if a decoder updates it concurrently.
+// Returns false for an unknown index.
+bool can_signal_get(int signal, can_signal_sample_t *out);
+
+int can_signal_find(const char *name);
+
+esp_err_t can_dispatch_register(httpd_handle_t server);
@@ -0,0 +1,205 @@
+#include "can_filter.h"
+
+#include <string.h>
+
+#define STD_ID_MASK 0x7FFu
+
+// Bit positions of the TWAI acceptance filter for standard frames
+// (see the ESP-IDF TWAI driver documentation, "Acceptance Filter").
+#define SINGLE_ID_SHIFT      21
+#define SINGLE_UNUSED_BITS   0x000F0000u
+#define SINGLE_DATA0_SHIFT   8
+#define DUAL1_ID_SHIFT       21
+#define DUAL2_ID_SHIFT       5
+
+typedef struct {
+    uint32_t id_code;
+    uint32_t id_diff;       // identifier bits that differ inside the group
+    uint8_t data_code[2];
+    uint8_t data_mask[2];   // 0xFF where the byte is not constrained
+    uint32_t ids_accepted;
+    uint8_t prefix_len;     // common prefix length, valid if uniform_prefix
+    bool uniform_prefix;    // every rule in the group has the same prefix
+    bool ids_dense;         // the group's IDs fill the masked ID space
+} filter_group_t;
+
+typedef struct {
+    uint32_t ids_accepted;
+    bool exact;
+    int data_bytes;         // payload bytes checked in hardware
+} filter_score_t;
+
+static int popcount32(uint32_t v) {
+    int n = 0;
+    while (v) {
+        v &= v - 1;
+        n++;
+    }
+    return n;
+}
+
+static void group_build(const can_rx_rule_t *rules, size_t count, uint32_t members, filter_group_t *g) {
+    uint32_t id_and = STD_ID_MASK, id_or = 0;
+    uint8_t d_and[2] = {0xFF, 0xFF}, d_or[2] = {0, 0};
+    bool d_used[2] = {true, true};
+    const can_rx_rule_t *first = NULL;
+    int distinct_ids = 0;
+
+    g->uniform_prefix = true;
+    for (size_t i = 0; i < count; i++) {
+        if (!(members & (1u << i))) {
+            continue;
+        }
+        const can_rx_rule_t *r = &rules[i];
+        uint32_t id = r->identifier & STD_ID_MASK;
+        id_and &= id;
+        id_or |= id;
+        for (int b = 0; b < 2; b++) {
+            if (r->prefix_len > b) {
+                d_and[b] &= r->prefix[b];
+                d_or[b] |= r->prefix[b];
+            } else {
+                d_used[b] = false;
+            }
+        }
+        if (first == NULL) {
+            first = r;
+        } else if (r->prefix_len != first->prefix_len ||
+                   memcmp(r->prefix, first->prefix, r->prefix_len) != 0) {
+            g->uniform_prefix = false;
+        }
+
+        bool seen = false;
+        for (size_t j = 0; j < i; j++) {
+            if ((members & (1u << j)) && (rules[j].identifier & STD_ID_MASK) == id) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen) {
+            distinct_ids++;
+        }
+    }
+
+    g->id_diff = id_and ^ id_or;
+    g->id_code = id_and;
+    g->ids_accepted = 1u << popcount32(g->id_diff);
+    g->ids_dense = (uint32_t)distinct_ids == g->ids_accepted;
+    g->prefix_len = first != NULL ? first->prefix_len : 0;
+    for (int b = 0; b < 2; b++) {
+        g->data_code[b] = d_used[b] ? d_and[b] : 0;
+        g->data_mask[b] = d_used[b] ? (uint8_t)(d_and[b] ^ d_or[b]) : 0xFF;
+    }
+}
+
+// A group is expressed exactly when its IDs form a full cube under the mask
+// and all of its rules share one prefix that fits in the bytes the filter
+// can check.
+static bool group_exact(const filter_group_t *g, int data_bytes) {
+    return g->ids_dense && g->uniform_prefix && g->prefix_len <= data_bytes;
+}
+
+static int group_data_bytes(const filter_group_t *g, int max_bytes) {
+    int n = 0;
+    for (int b = 0; b < max_bytes; b++) {
+        if (g->data_mask[b] != 0xFF) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static bool score_better(const filter_score_t *a, const filter_score_t *b) {
+    if (a->ids_accepted != b->ids_accepted) {
+        return a->ids_accepted < b->ids_accepted;
+    }
+    if (a->exact != b->exact) {
+        return a->exact;
+    }
+    return a->data_bytes > b->data_bytes;
+}
+
+static void emit_single(const filter_group_t *g, can_hw_filter_t *out) {
+    out->single_filter = true;
+    out->acceptance_code = (g->id_code << SINGLE_ID_SHIFT) |
+                           ((uint32_t)g->data_code[0] << SINGLE_DATA0_SHIFT) |
+                           g->data_code[1];
+    out->acceptance_mask = (g->id_diff << SINGLE_ID_SHIFT) |
+                           SINGLE_UNUSED_BITS |
+                           ((uint32_t)g->data_mask[0] << SINGLE_DATA0_SHIFT) |
+                           g->data_mask[1];
+    out->ids_accepted = g->ids_accepted;
+    out->exact = group_exact(g, 2);
+}
+
+// Filter 1 checks the identifier and the first data byte (split across
+// bits 19:16 and 3:0), filter 2 checks the identifier only.
+static void emit_dual(const filter_group_t *g1, const filter_group_t *g2, can_hw_filter_t *out) {
+    uint32_t d0 = g1->data_code[0], m0 = g1->data_mask[0];
+
+    out->single_filter = false;
+    out->acceptance_code = (g1->id_code << DUAL1_ID_SHIFT) |
+                           ((d0 & 0xF0u) << 12) | (d0 & 0x0Fu) |
+                           (g2->id_code << DUAL2_ID_SHIFT);
+    out->acceptance_mask = (g1->id_diff << DUAL1_ID_SHIFT) |
+                           ((m0 & 0xF0u) << 12) | (m0 & 0x0Fu) |
+                           (g2->id_diff << DUAL2_ID_SHIFT);
+    out->ids_accepted = g1->ids_accepted + g2->ids_accepted;
+    out->exact = group_exact(g1, 1) && group_exact(g2, 0);
+}
+
+void can_filter_compute(const can_rx_rule_t *rules, size_t count, can_hw_filter_t *out) {
+    if (count == 0 || count > CAN_FILTER_MAX_RULES) {
+        out->acceptance_code = 0;
+        out->acceptance_mask = 0xFFFFFFFF;
+        out->single_filter = true;
+        out->exact = false;
+        out->ids_accepted = STD_ID_MASK + 1;
+        return;
+    }
+
+    uint32_t all = (1u << count) - 1;
+    filter_group_t single;
+    group_build(rules, count, all, &single);
+    emit_single(&single, out);
+
+    filter_score_t best = {
+        .ids_accepted = out->ids_accepted,
+        .exact = out->exact,
+        .data_bytes = group_data_bytes(&single, 2),
+    };
+
+    // Try every split of the rules into two non-empty groups, with either
+    // group on filter 1. Rule 0 stays in group A to skip mirrored splits.
+    for (uint32_t a = 1; a < all; a += 2) {
+        filter_group_t ga, gb;
+        group_build(rules, count, a, &ga);
+        group_build(rules, count, all & ~a, &gb);
+
+        const filter_group_t *orders[2][2] = {{&ga, &gb}, {&gb, &ga}};
+        for (int o = 0; o < 2; o++) {
+            const filter_group_t *g1 = orders[o][0], *g2 = orders[o][1];
+            filter_score_t s = {
+                .ids_accepted = g1->ids_accepted + g2->ids_accepted,
+                .exact = group_exact(g1, 1) && group_exact(g2, 0),
+                .data_bytes = group_data_bytes(g1, 1),
+            };
+            if (score_better(&s, &best)) {
+                best = s;
+                emit_dual(g1, g2, out);
+            }
+        }
+    }
+}
+
+int can_filter_match(const can_rx_rule_t *rules, size_t count,
+                     uint32_t identifier, const uint8_t *data, uint8_t dlc) {
+    for (size_t i = 0; i < count; i++) {
+        const can_rx_rule_t *r = &rules[i];
+        if (r->identifier == identifier && dlc >= r->prefix_len &&
+            memcmp(r->prefix, data, r->prefix_len) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAN_FILTER_MAX_PREFIX 8
+#define CAN_FILTER_MAX_RULES  16
+
+// A frame we want to see: standard 11-bit identifier plus an optional
+// payload prefix that must match byte for byte.
+typedef struct {
+    uint32_t identifier;
+    uint8_t prefix[CAN_FILTER_MAX_PREFIX];
+    uint8_t prefix_len;
+} can_rx_rule_t;
+
+// Acceptance code/mask in the layout expected by twai_filter_config_t.
+// A set mask bit means "don't care".
+typedef struct {
+    uint32_t acceptance_code;
+    uint32_t acceptance_mask;
+    bool single_filter;
+    bool exact;             // true if the controller alone accepts exactly the rule set
+    uint32_t ids_accepted;  // number of distinct 11-bit IDs the filter lets through
+} can_hw_filter_t;
+
+// Computes the tightest single or dual filter covering every rule. Rule sets
+// that cannot be expressed exactly produce a superset and exact == false, in
+// which case the caller must keep matching in software.
+void can_filter_compute(const can_rx_rule_t *rules, size_t count, can_hw_filter_t *out);
+
+// Software matcher. Returns the index of the first matching rule or -1.
+int can_filter_match(const can_rx_rule_t *rules, size_t count,
+                     uint32_t identifier, const uint8_t *data, uint8_t dlc);
@@ -0,0 +1,416 @@
+#include "capture.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "boot.h"
+#include "low_latency.h"
+
+#define CAPTURE_DRAIN_MS    20      // writer wake-up period while capturing
+#define CAPTURE_CHUNK_SIZE  1024    // text buffered per httpd_resp_send_chunk()
+#define CAPTURE_LINE_MAX    96      // longest candump/ASC line
+
+static const char *TAG = "CAPTURE";
+
+// RX task -> writer task. Single producer, single consumer.
+static capture_frame_t ram_ring[CAPTURE_RAM_FRAMES];
+static _Atomic uint32_t ram_head;
+static _Atomic uint32_t ram_tail;
+static _Atomic uint32_t ram_lost;
+static atomic_bool active;
+static atomic_bool new_session;
+
+static const esp_partition_t *partition;
+static uint32_t sector_count;
+static TaskHandle_t writer_task_handle;
+
+// Log state, guarded by log_lock. Block `seq` lives in sector
+// (next_sector + sector_count - (next_seq - seq)) % sector_count.
+static SemaphoreHandle_t log_lock;
+static uint32_t next_sector;
+static uint32_t next_seq;
+static uint32_t oldest_seq;     // oldest block that may still be in flash
+static uint32_t session_seq;    // first block of the latest session
+
+// Block being filled: header followed by the encoded records.
+static uint8_t page[CAPTURE_BLOCK_SIZE];
+static capture_block_hdr_t *const page_hdr = (capture_block_hdr_t *)page;
+static capture_frame_t page_prev;
+
+LOW_LATENCY_IRAM void capture_record(uint32_t identifier, uint8_t flags, uint8_t dlc, const uint8_t *data, int64_t timestamp_us) {
+    if (!atomic_load_explicit(&active, memory_order_relaxed)) {
+        return;
+    }
+    uint32_t head = atomic_load_explicit(&ram_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ram_tail, memory_order_acquire) >= CAPTURE_RAM_FRAMES) {
+        atomic_fetch_add_explicit(&ram_lost, 1, memory_order_relaxed);
+        return;
+    }
+    capture_frame_t *f = &ram_ring[head & (CAPTURE_RAM_FRAMES - 1)];
+    f->timestamp_us = timestamp_us;
+    f->identifier = identifier;
+    f->flags = flags;
+    f->dlc = dlc > 8 ? 8 : dlc;
+    memcpy(f->data, data, sizeof(f->data));
+    atomic_store_explicit(&ram_head, head + 1, memory_order_release);
+}
+
+static void page_reset(void) {
+    memset(page_hdr, 0, sizeof(*page_hdr));
+    page_hdr->magic = CAPTURE_BLOCK_MAGIC;
+}
+
+// Writes the block being filled to the next sector. Called with log_lock.
+static void page_flush(void) {
+    if (page_hdr->count == 0) {
+        return;
+    }
+    page_hdr->seq = next_seq;
+    size_t offset = (size_t)next_sector * CAPTURE_BLOCK_SIZE;
+    esp_err_t err = esp_partition_erase_range(partition, offset, CAPTURE_BLOCK_SIZE);
+    if (err == ESP_OK) {
+        err = esp_partition_write(partition, offset, page, sizeof(capture_block_hdr_t) + page_hdr->len);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write block %lu: %s", (unsigned long)next_seq, esp_err_to_name(err));
+    }
+
+    next_seq++;
+    next_sector = (next_sector + 1) % sector_count;
+    if (next_seq - oldest_seq > sector_count) {
+        oldest_seq = next_seq - sector_count;
+    }
+    page_reset();
+}
+
+static void page_append(const capture_frame_t *f) {
+    if (page_hdr->count == 0) {
+        page_hdr->first_us = f->timestamp_us;
+        if (atomic_exchange(&new_session, false)) {
+            page_hdr->flags |= CAPTURE_BLOCK_SESSION_START;
+            session_seq = next_seq;
+        }
+    }
+    uint8_t *payload = page + sizeof(capture_block_hdr_t);
+    const capture_frame_t *prev = page_hdr->count ? &page_prev : NULL;
+    size_t n = capture_encode(payload + page_hdr->len, CAPTURE_BLOCK_PAYLOAD - page_hdr->len, f, prev);
+    if (n == 0) {
+        page_flush();
+        page_append(f);
+        return;
+    }
+    page_hdr->len += n;
+    page_hdr->count++;
+    page_prev = *f;
+}
+
+static void capture_writer_task(void *pvParameters) {
+    while (1) {
+        bool running = atomic_load(&active);
+        ulTaskNotifyTake(pdTRUE, running ? pdMS_TO_TICKS(CAPTURE_DRAIN_MS) : portMAX_DELAY);
+
+        xSemaphoreTake(log_lock, portMAX_DELAY);
+        uint32_t tail = atomic_load_explicit(&ram_tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&ram_head, memory_order_acquire);
+        while (tail != head) {
+            if (page_hdr->count == 0) {
+                page_hdr->lost = (uint16_t)atomic_exchange(&ram_lost, 0);
+            }
+            page_append(&ram_ring[tail & (CAPTURE_RAM_FRAMES - 1)]);
+            tail++;
+            atomic_store_explicit(&ram_tail, tail, memory_order_release);
+        }
+        if (!atomic_load(&active)) {
+            page_flush();
+        }
+        xSemaphoreGive(log_lock);
+    }
+}
+
+// Rebuilds the log state from the block headers left in flash.
+static void scan_log(void) {
+    bool found = false;
+    uint32_t newest = 0, newest_sector = 0, oldest = 0, session = 0;
+    bool have_session = false;
+
+    for (uint32_t i = 0; i < sector_count; i++) {
+        capture_block_hdr_t hdr;
+        if (esp_partition_read(partition, (size_t)i * CAPTURE_BLOCK_SIZE, &hdr, sizeof(hdr)) != ESP_OK ||
+            hdr.magic != CAPTURE_BLOCK_MAGIC || hdr.len > CAPTURE_BLOCK_PAYLOAD) {
+            continue;
+        }
+        if (!found || (int32_t)(hdr.seq - newest) > 0) {
+            newest = hdr.seq;
+            newest_sector = i;
+        }
+        if (!found || (int32_t)(hdr.seq - oldest) < 0) {
+            oldest = hdr.seq;
+        }
+        if ((hdr.flags & CAPTURE_BLOCK_SESSION_START) &&
+            (!have_session || (int32_t)(hdr.seq - session) > 0)) {
+            session = hdr.seq;
+            have_session = true;
+        }
+        found = true;
+    }
+
+    if (found) {
+        next_seq = newest + 1;
+        next_sector = (newest_sector + 1) % sector_count;
+        oldest_seq = (next_seq - oldest > sector_count) ? next_seq - sector_count : oldest;
+        session_seq = have_session ? session : oldest_seq;
+        ESP_LOGI(TAG, "Log holds blocks %lu..%lu, last session from %lu",
+                 (unsigned long)oldest_seq, (unsigned long)newest, (unsigned long)session_seq);
+    } else {
+        next_seq = oldest_seq = session_seq = 0;
+        next_sector = 0;
+        ESP_LOGI(TAG, "Log is empty");
+    }
+}
+
+esp_err_t capture_init(UBaseType_t priority) {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         CAPTURE_PARTITION_LABEL);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "No \"%s\" partition, capture disabled", CAPTURE_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    sector_count = partition->size / CAPTURE_BLOCK_SIZE;
+    ESP_LOGI(TAG, "Partition at 0x%lx, %lu blocks", (unsigned long)partition->address, (unsigned long)sector_count);
+
+    scan_log();
+    page_reset();
+
+    log_lock = xSemaphoreCreateMutex();
+    if (log_lock == NULL ||
+        xTaskCreate(capture_writer_task, "capture_task", 4096, NULL, priority, &writer_task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t capture_start(void) {
+    if (writer_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!atomic_load(&active)) {
+        atomic_store(&ram_lost, 0);
+        atomic_store(&new_session, true);
+        atomic_store(&active, true);
+        xTaskNotifyGive(writer_task_handle);
+        ESP_LOGI(TAG, "Capture started");
+    }
+    return ESP_OK;
+}
+
+void capture_stop(void) {
+    if (atomic_exchange(&active, false)) {
+        xTaskNotifyGive(writer_task_handle);
+        ESP_LOGI(TAG, "Capture stopped");
+    }
+}
+
+bool capture_active(void) {
+    return atomic_load(&active);
+}
+
+typedef struct {
+    httpd_req_t *req;
+    capture_fmt_t fmt;
+    char text[CAPTURE_CHUNK_SIZE];
+    size_t text_len;
+    int64_t t0_us;              // first frame streamed, for ASC times
+} capture_stream_t;
+
+static esp_err_t stream_flush(capture_stream_t *s) {
+    esp_err_t err = ESP_OK;
+    if (s->text_len > 0) {
+        err = httpd_resp_send_chunk(s->req, s->text, s->text_len);
+        s->text_len = 0;
+    }
+    return err;
+}
+
+static esp_err_t stream_block(capture_stream_t *s, const uint8_t *block) {
+    const capture_block_hdr_t *hdr = (const capture_block_hdr_t *)block;
+
+    if (s->fmt == CAPTURE_FMT_BIN) {
+        return httpd_resp_send_chunk(s->req, (const char *)block, sizeof(*hdr) + hdr->len);
+    }
+
+    capture_decoder_t dec;
+    capture_frame_t frame;
+    capture_decoder_init(&dec, hdr, block + sizeof(*hdr));
+    while (capture_decode_next(&dec, &frame)) {
+        if (s->t0_us < 0) {
+            s->t0_us = frame.timestamp_us;
+        }
+        if (sizeof(s->text) - s->text_len < CAPTURE_LINE_MAX && stream_flush(s) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        s->text_len += capture_format_frame(s->text + s->text_len, sizeof(s->text) - s->text_len,
+                                            s->fmt, &frame, s->t0_us);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t capture_get_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_CAPTURE))) {
+        return ESP_OK;
+    }
+    if (writer_task_handle == NULL) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No capture partition");
+        return ESP_FAIL;
+    }
+
+    char query[48] = "", value[16];
+    httpd_req_get_url_query_str(req, query, sizeof(query));
+    capture_fmt_t fmt = CAPTURE_FMT_CANDUMP;
+    if (httpd_query_key_value(query, "format", value, sizeof(value)) == ESP_OK) {
+        if (strcmp(value, "asc") == 0) {
+            fmt = CAPTURE_FMT_ASC;
+        } else if (strcmp(value, "bin") == 0) {
+            fmt = CAPTURE_FMT_BIN;
+        } else if (strcmp(value, "candump") != 0) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "format must be candump, asc or bin");
+            return ESP_FAIL;
+        }
+    }
+    bool whole_log = httpd_query_key_value(query, "scope", value, sizeof(value)) == ESP_OK &&
+                     strcmp(value, "all") == 0;
+
+    static const char *const disposition[] = {
+        [CAPTURE_FMT_CANDUMP] = "attachment; filename=\"capture.log\"",
+        [CAPTURE_FMT_ASC]     = "attachment; filename=\"capture.asc\"",
+        [CAPTURE_FMT_BIN]     = "attachment; filename=\"capture.bin\"",
+    };
+    httpd_resp_set_type(req, fmt == CAPTURE_FMT_BIN ? "application/octet-stream" : "text/plain");
+    httpd_resp_set_hdr(req, "Content-Disposition", disposition[fmt]);
+
+    capture_stream_t *s = malloc(sizeof(*s));
+    uint8_t *block = malloc(CAPTURE_BLOCK_SIZE);
+    if (s == NULL || block == NULL) {
+        free(s);
+        free(block);
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    s->req = req;
+    s->fmt = fmt;
+    s->t0_us = -1;
+    s->text_len = capture_format_begin(s->text, sizeof(s->text), fmt);
+
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    uint32_t seq = whole_log ? oldest_seq : session_seq;
+    xSemaphoreGive(log_lock);
+
+    // Walk the flash blocks in order, following the writer if it appends
+    // more while we stream, then finish with the block still in RAM.
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK) {
+        xSemaphoreTake(log_lock, portMAX_DELAY);
+        uint32_t end = next_seq;
+        uint32_t sector = next_sector;
+        if (seq == end) {
+            memcpy(block, page, sizeof(capture_block_hdr_t) + page_hdr->len);
+            ((capture_block_hdr_t *)block)->seq = end;
+            xSemaphoreGive(log_lock);
+            if (((capture_block_hdr_t *)block)->count > 0) {
+                err = stream_block(s, block);
+            }
+            break;
+        }
+        xSemaphoreGive(log_lock);
+
+        if (end - seq > sector_count) {
+            seq = end - sector_count;   // overwritten while we were streaming
+        }
+        sector = (sector + sector_count - (end - seq)) % sector_count;
+        const capture_block_hdr_t *hdr = (const capture_block_hdr_t *)block;
+        if (esp_partition_read(partition, (size_t)sector * CAPTURE_BLOCK_SIZE, block, CAPTURE_BLOCK_SIZE) == ESP_OK &&
+            hdr->magic == CAPTURE_BLOCK_MAGIC && hdr->seq == seq && hdr->len <= CAPTURE_BLOCK_PAYLOAD) {
+            err = stream_block(s, block);
+        }
+        seq++;
+    }
+
+    if (err == ESP_OK) {
+        s->text_len += capture_format_end(s->text + s->text_len, sizeof(s->text) - s->text_len, fmt);
+        err = stream_flush(s);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    } else {
+        ESP_LOGW(TAG, "Download aborted: %s", esp_err_to_name(err));
+    }
+    free(block);
+    free(s);
+    return err;
+}
+
+static esp_err_t send_capture_state(httpd_req_t *req) {
+    char response[96];
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    snprintf(response, sizeof(response), "{\"active\":%s,\"session_blocks\":%lu,\"blocks\":%lu}",
+             capture_active() ? "true" : "false",
+             (unsigned long)(next_seq - session_seq), (unsigned long)(next_seq - oldest_seq));
+    xSemaphoreGive(log_lock);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t capture_start_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_CAPTURE))) {
+        return ESP_OK;
+    }
+    if (capture_start() != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Capture unavailable");
+        return ESP_FAIL;
+    }
+    return send_capture_state(req);
+}
+
+static esp_err_t capture_stop_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_CAPTURE))) {
+        return ESP_OK;
+    }
+    if (writer_task_handle == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Capture unavailable");
+        return ESP_FAIL;
+    }
+    capture_stop();
+    return send_capture_state(req);
+}
+
+esp_err_t capture_register(httpd_handle_t server) {
+    httpd_uri_t uri_capture = {
+        .uri       = "/capture",
+        .method    = HTTP_GET,
+        .handler   = capture_get_handler,
+        .user_ctx  = NULL
+    };
+    httpd_uri_t uri_capture_start = {
+        .uri       = "/capture/start",
+        .method    = HTTP_POST,
+        .handler   = capture_start_handler,
+        .user_ctx  = NULL
+    };
+    httpd_uri_t uri_capture_stop = {
+        .uri       = "/capture/stop",
+        .method    = HTTP_POST,
+        .handler   = capture_stop_handler,
+        .user_ctx  = NULL
+    };
+    esp_err_t err = httpd_register_uri_handler(server, &uri_capture);
+    if (err == ESP_OK) {
+        err = httpd_register_uri_handler(server, &uri_capture_start);
+    }
+    if (err == ESP_OK) {
+        err = httpd_register_uri_handler(server, &uri_capture_stop);
+    }
+    return err;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "capture_format.h"
+
+// Bus capture log. While a capture is running the RX task hands every
+// frame the controller accepted to capture_record(), which only copies it
+// into a RAM ring. A low-priority writer task delta-encodes the frames
+// into sector-sized blocks and appends them to the "capture" flash
+// partition, which is used as a circular log: once full, the oldest
+// blocks are overwritten. The log survives a reboot.
+//
+//   POST /capture/start            begins a new session
+//   POST /capture/stop             stops and flushes the partial block
+//   GET  /capture?format=candump|asc|bin[&scope=all]
+//                                  streams the current session (or the
+//                                  whole log) as a chunked response
+
+#define CAPTURE_RAM_FRAMES      1024    // must be a power of two
+#define CAPTURE_PARTITION_LABEL "capture"
+_Static_assert((CAPTURE_RAM_FRAMES & (CAPTURE_RAM_FRAMES - 1)) == 0, "CAPTURE_RAM_FRAMES must be a power of two");
+
+esp_err_t capture_init(UBaseType_t priority);
+esp_err_t capture_register(httpd_handle_t server);
+
+esp_err_t capture_start(void);
+void capture_stop(void);
+bool capture_active(void);
+
+// RX task hook. Never blocks; frames that do not fit in the RAM ring are
+// counted as lost and reported in the next block header.
+void capture_record(uint32_t identifier, uint8_t flags, uint8_t dlc, const uint8_t *data, int64_t timestamp_us);
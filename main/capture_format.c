@@ -0,0 +1,166 @@
+#include "capture_format.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#define REC_DLC_MASK    0x0F
+#define REC_SAME_ID     0x10
+#define REC_EXTD        0x20
+#define REC_RTR         0x40
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+size_t capture_encode(uint8_t *out, size_t cap, const capture_frame_t *frame, const capture_frame_t *prev) {
+    uint8_t tmp[5 + 1 + 4 + 8];
+    size_t n = 0;
+
+    int64_t gap_us = prev != NULL ? frame->timestamp_us - prev->timestamp_us : 0;
+    if (gap_us < 0 || gap_us > UINT32_MAX) {
+        return 0;   // start a new block instead
+    }
+    uint32_t delta = (uint32_t)gap_us;
+    do {
+        uint8_t b = delta & 0x7F;
+        delta >>= 7;
+        tmp[n++] = b | (delta ? 0x80 : 0);
+    } while (delta);
+
+    bool extd = frame->flags & CAPTURE_FLAG_EXTD;
+    bool rtr = frame->flags & CAPTURE_FLAG_RTR;
+    bool same_id = prev != NULL && prev->identifier == frame->identifier &&
+                   (prev->flags & CAPTURE_FLAG_EXTD) == (frame->flags & CAPTURE_FLAG_EXTD);
+    uint8_t dlc = frame->dlc > 8 ? 8 : frame->dlc;
+
+    tmp[n++] = dlc | (same_id ? REC_SAME_ID : 0) | (extd ? REC_EXTD : 0) | (rtr ? REC_RTR : 0);
+    if (!same_id) {
+        tmp[n++] = (uint8_t)frame->identifier;
+        tmp[n++] = (uint8_t)(frame->identifier >> 8);
+        if (extd) {
+            tmp[n++] = (uint8_t)(frame->identifier >> 16);
+            tmp[n++] = (uint8_t)(frame->identifier >> 24);
+        }
+    }
+    if (!rtr) {
+        memcpy(&tmp[n], frame->data, dlc);
+        n += dlc;
+    }
+
+    if (n > cap) {
+        return 0;
+    }
+    memcpy(out, tmp, n);
+    return n;
+}
+
+void capture_decoder_init(capture_decoder_t *dec, const capture_block_hdr_t *hdr, const uint8_t *payload) {
+    dec->p = payload;
+    dec->end = payload + hdr->len;
+    memset(&dec->prev, 0, sizeof(dec->prev));
+    dec->prev.timestamp_us = hdr->first_us;
+}
+
+bool capture_decode_next(capture_decoder_t *dec, capture_frame_t *frame) {
+    const uint8_t *p = dec->p;
+    uint32_t delta = 0;
+    int shift = 0;
+
+    do {
+        if (p >= dec->end || shift > 28) {
+            return false;
+        }
+        delta |= (uint32_t)(*p & 0x7F) << shift;
+        shift += 7;
+    } while (*p++ & 0x80);
+
+    if (p >= dec->end) {
+        return false;
+    }
+    uint8_t hdr = *p++;
+    frame->timestamp_us = dec->prev.timestamp_us + delta;
+    frame->dlc = hdr & REC_DLC_MASK;
+    frame->flags = ((hdr & REC_EXTD) ? CAPTURE_FLAG_EXTD : 0) | ((hdr & REC_RTR) ? CAPTURE_FLAG_RTR : 0);
+
+    if (hdr & REC_SAME_ID) {
+        frame->identifier = dec->prev.identifier;
+    } else {
+        size_t id_len = (hdr & REC_EXTD) ? 4 : 2;
+        if ((size_t)(dec->end - p) < id_len) {
+            return false;
+        }
+        frame->identifier = p[0] | ((uint32_t)p[1] << 8);
+        if (id_len == 4) {
+            frame->identifier |= ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        }
+        p += id_len;
+    }
+
+    memset(frame->data, 0, sizeof(frame->data));
+    if (!(hdr & REC_RTR)) {
+        if (frame->dlc > 8 || (size_t)(dec->end - p) < frame->dlc) {
+            return false;
+        }
+        memcpy(frame->data, p, frame->dlc);
+        p += frame->dlc;
+    }
+
+    dec->p = p;
+    dec->prev = *frame;
+    return true;
+}
+
+size_t capture_format_begin(char *buf, size_t cap, capture_fmt_t fmt) {
+    if (fmt != CAPTURE_FMT_ASC) {
+        return 0;
+    }
+    // The device has no wall clock; times are seconds since the first frame.
+    int n = snprintf(buf, cap,
+                     "date Thu Jan 1 00:00:00.000 am 1970\n"
+                     "base hex  timestamps absolute\n"
+                     "no internal events logged\n"
+                     "// version 7.0.0\n"
+                     "Begin Triggerblock Thu Jan 1 00:00:00.000 am 1970\n");
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+size_t capture_format_frame(char *buf, size_t cap, capture_fmt_t fmt, const capture_frame_t *frame, int64_t t0_us) {
+    char data[3 * 8 + 1];
+    size_t d = 0;
+    bool rtr = frame->flags & CAPTURE_FLAG_RTR;
+    bool extd = frame->flags & CAPTURE_FLAG_EXTD;
+    int n;
+
+    if (fmt == CAPTURE_FMT_CANDUMP) {
+        for (int i = 0; !rtr && i < frame->dlc; i++) {
+            data[d++] = hex_digits[frame->data[i] >> 4];
+            data[d++] = hex_digits[frame->data[i] & 0x0F];
+        }
+        data[d] = '\0';
+        n = snprintf(buf, cap, extd ? "(%" PRId64 ".%06" PRId64 ") can0 %08" PRIX32 "#%s%s\n"
+                                    : "(%" PRId64 ".%06" PRId64 ") can0 %03" PRIX32 "#%s%s\n",
+                     frame->timestamp_us / 1000000, frame->timestamp_us % 1000000,
+                     frame->identifier, rtr ? "R" : "", data);
+    } else if (fmt == CAPTURE_FMT_ASC) {
+        for (int i = 0; !rtr && i < frame->dlc; i++) {
+            data[d++] = ' ';
+            data[d++] = hex_digits[frame->data[i] >> 4];
+            data[d++] = hex_digits[frame->data[i] & 0x0F];
+        }
+        data[d] = '\0';
+        int64_t t = frame->timestamp_us - t0_us;
+        n = snprintf(buf, cap, "%4" PRId64 ".%06" PRId64 " 1  %" PRIX32 "%s             Rx   %s %u%s\n",
+                     t / 1000000, t % 1000000, frame->identifier, extd ? "x" : "",
+                     rtr ? "r" : "d", frame->dlc, data);
+    } else {
+        return 0;
+    }
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+size_t capture_format_end(char *buf, size_t cap, capture_fmt_t fmt) {
+    if (fmt != CAPTURE_FMT_ASC) {
+        return 0;
+    }
+    int n = snprintf(buf, cap, "End TriggerBlock\n");
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// On-flash format of the CAN capture log and its text renderings.
+//
+// The log is a sequence of blocks, one per flash sector. Each block is a
+// capture_block_hdr_t followed by `len` bytes of delta-encoded records:
+//
+//   varint  time since the previous record in the block, in microseconds
+//           (the first record is at hdr.first_us)
+//   u8      bits 3:0 DLC, bit 4 same ID as previous record, bit 5 extended
+//           ID, bit 6 remote frame
+//   u16/u32 identifier, little endian, omitted when "same ID" is set
+//   u8[DLC] payload, omitted for remote frames
+//
+// A typical 8-byte frame takes 11-13 bytes instead of 24 in RAM.
+
+#define CAPTURE_BLOCK_SIZE   4096
+#define CAPTURE_BLOCK_MAGIC  0x54504143u    // "CAPT"
+
+#define CAPTURE_BLOCK_SESSION_START 0x0001  // first block after capture_start()
+
+#define CAPTURE_FLAG_EXTD   0x01
+#define CAPTURE_FLAG_RTR    0x02
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;           // increases by one per block written
+    int64_t first_us;       // esp_timer time of the first record
+    uint16_t count;         // records in the block
+    uint16_t len;           // encoded bytes following the header
+    uint16_t lost;          // frames dropped before this block (RAM overrun)
+    uint16_t flags;
+} capture_block_hdr_t;
+
+#define CAPTURE_BLOCK_PAYLOAD (CAPTURE_BLOCK_SIZE - sizeof(capture_block_hdr_t))
+
+typedef struct {
+    int64_t timestamp_us;
+    uint32_t identifier;
+    uint8_t flags;
+    uint8_t dlc;
+    uint8_t data[8];
+} capture_frame_t;
+
+typedef enum {
+    CAPTURE_FMT_CANDUMP,    // can-utils log: (sec.usec) can0 762#2300...
+    CAPTURE_FMT_ASC,        // Vector ASCII log
+    CAPTURE_FMT_BIN,        // raw blocks as stored in flash
+} capture_fmt_t;
+
+// Appends one frame to a block payload. prev is the previous frame in the
+// same block, or NULL for the first one. Returns bytes written, or 0 if the
+// frame does not fit or is too far from prev; it then opens the next block.
+size_t capture_encode(uint8_t *out, size_t cap, const capture_frame_t *frame, const capture_frame_t *prev);
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    capture_frame_t prev;
+} capture_decoder_t;
+
+void capture_decoder_init(capture_decoder_t *dec, const capture_block_hdr_t *hdr, const uint8_t *payload);
+
+// Returns false at the end of the block or on malformed data.
+bool capture_decode_next(capture_decoder_t *dec, capture_frame_t *frame);
+
+// Text output. t0_us is the timestamp that ASC times are relative to.
+size_t capture_format_begin(char *buf, size_t cap, capture_fmt_t fmt);
+size_t capture_format_frame(char *buf, size_t cap, capture_fmt_t fmt, const capture_frame_t *frame, int64_t t0_us);
+size_t capture_format_end(char *buf, size_t cap, capture_fmt_t fmt);
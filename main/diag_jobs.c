@@ -0,0 +1,331 @@
+#include "diag_jobs.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "boot.h"
+#include "low_latency.h"
+#include "ws_push.h"
+
+static const char *TAG = "DIAG_JOBS";
+
+static diag_job_t jobs[DIAG_JOBS_MAX];
+static uint32_t next_id = 1;
+static SemaphoreHandle_t jobs_lock;
+static TaskHandle_t worker_handle;
+static int event_source = -1;
+
+static const char *const state_names[] = {"queued", "running", "done"};
+
+// Jobs ahead of job in the queue. Called with jobs_lock held.
+static uint32_t position_of(const diag_job_t *job) {
+    uint32_t n = 0;
+    if (job->state != DIAG_JOB_QUEUED) {
+        return 0;
+    }
+    for (int i = 0; i < DIAG_JOBS_MAX; i++) {
+        if (jobs[i].id != 0 && jobs[i].id < job->id && jobs[i].state != DIAG_JOB_DONE) {
+            n++;
+        }
+    }
+    return n;
+}
+
+// Oldest queued job. Called with jobs_lock held.
+static diag_job_t *next_queued(void) {
+    diag_job_t *next = NULL;
+    for (int i = 0; i < DIAG_JOBS_MAX; i++) {
+        if (jobs[i].id != 0 && jobs[i].state == DIAG_JOB_QUEUED && (next == NULL || jobs[i].id < next->id)) {
+            next = &jobs[i];
+        }
+    }
+    return next;
+}
+
+static void diag_jobs_task(void *pvParameters) {
+    while (1) {
+        xSemaphoreTake(jobs_lock, portMAX_DELAY);
+        diag_job_t *job = next_queued();
+        if (job != NULL) {
+            job->state = DIAG_JOB_RUNNING;
+            job->start_us = esp_timer_get_time();
+        }
+        xSemaphoreGive(jobs_lock);
+        if (job == NULL) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        ws_push_event(event_source);
+
+        // The slot cannot be recycled while it is running, so the engine
+        // updates the job's result in place.
+        low_latency_acquire();
+        seq_run(job->sequence, &job->result);
+        low_latency_release();
+
+        xSemaphoreTake(jobs_lock, portMAX_DELAY);
+        job->end_us = esp_timer_get_time();
+        job->state = DIAG_JOB_DONE;
+        ESP_LOGI(TAG, "Job %" PRIu32 " (%s) finished in %" PRId64 " us (%" PRId64 " us queued, %" PRIu32
+                 " steps, %" PRIu32 " clients): %s",
+                 job->id, job->sequence, job->end_us - job->start_us, job->start_us - job->queued_us,
+                 job->result.steps, job->clients, esp_err_to_name(job->result.err));
+        xSemaphoreGive(jobs_lock);
+        ws_push_event(event_source);
+    }
+}
+
+static void copy_out(const diag_job_t *job, diag_job_t *out) {
+    *out = *job;
+    out->position = position_of(job);
+}
+
+esp_err_t diag_jobs_submit(const char *sequence, diag_job_t *out) {
+    if (!seq_name_valid(sequence)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(jobs_lock, portMAX_DELAY);
+    diag_job_t *job = NULL, *slot = NULL;
+    for (int i = 0; i < DIAG_JOBS_MAX; i++) {
+        diag_job_t *j = &jobs[i];
+        if (j->id != 0 && j->state == DIAG_JOB_QUEUED && strcmp(j->sequence, sequence) == 0) {
+            job = j;
+            break;
+        }
+        // An unused slot, else the oldest finished job
+        if (j->id == 0) {
+            if (slot == NULL || slot->id != 0) {
+                slot = j;
+            }
+        } else if (j->state == DIAG_JOB_DONE && (slot == NULL || (slot->id != 0 && j->id < slot->id))) {
+            slot = j;
+        }
+    }
+
+    esp_err_t err = ESP_OK;
+    if (job != NULL) {
+        job->clients++;
+    } else if (slot == NULL) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        job = slot;
+        memset(job, 0, sizeof(*job));
+        job->id = next_id++;
+        strcpy(job->sequence, sequence);
+        job->state = DIAG_JOB_QUEUED;
+        job->clients = 1;
+        job->queued_us = esp_timer_get_time();
+    }
+    if (job != NULL) {
+        copy_out(job, out);
+    }
+    xSemaphoreGive(jobs_lock);
+
+    if (err == ESP_OK && out->clients == 1) {
+        xTaskNotifyGive(worker_handle);
+        ws_push_event(event_source);
+    }
+    return err;
+}
+
+esp_err_t diag_jobs_cancel(uint32_t id) {
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    bool removed = false;
+    xSemaphoreTake(jobs_lock, portMAX_DELAY);
+    for (int i = 0; i < DIAG_JOBS_MAX; i++) {
+        diag_job_t *job = &jobs[i];
+        if (id == 0 || job->id != id) {
+            continue;
+        }
+        if (job->state == DIAG_JOB_RUNNING) {
+            err = ESP_ERR_INVALID_STATE;
+        } else if (job->state == DIAG_JOB_QUEUED) {
+            err = ESP_OK;
+            if (--job->clients == 0) {
+                ESP_LOGI(TAG, "Job %" PRIu32 " (%s) cancelled", job->id, job->sequence);
+                memset(job, 0, sizeof(*job));
+                removed = true;
+            }
+        }
+        break;
+    }
+    xSemaphoreGive(jobs_lock);
+
+    if (removed) {
+        ws_push_event(event_source);
+    }
+    return err;
+}
+
+bool diag_jobs_get(uint32_t id, diag_job_t *out) {
+    bool found = false;
+    xSemaphoreTake(jobs_lock, portMAX_DELAY);
+    for (int i = 0; i < DIAG_JOBS_MAX; i++) {
+        if (id != 0 && jobs[i].id == id) {
+            copy_out(&jobs[i], out);
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(jobs_lock);
+    return found;
+}
+
+bool diag_jobs_succeeded(const diag_job_t *job) {
+    return job->state == DIAG_JOB_DONE && job->result.err == ESP_OK && job->result.nrc == 0;
+}
+
+size_t diag_jobs_json(char *buf, size_t cap, const diag_job_t *job) {
+    char result[32];
+    if (job->state == DIAG_JOB_DONE) {
+        snprintf(result, sizeof(result), "\"%s\"", esp_err_to_name(job->result.err));
+    } else {
+        strcpy(result, "null");
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t wait_us = (job->state == DIAG_JOB_QUEUED ? now : job->start_us) - job->queued_us;
+    int64_t elapsed_us = (job->state == DIAG_JOB_DONE ? job->end_us : now) - job->queued_us;
+
+    int n = snprintf(buf, cap,
+                     "{\"id\":%" PRIu32 ",\"sequence\":\"%s\",\"state\":\"%s\",\"position\":%" PRIu32
+                     ",\"clients\":%" PRIu32 ",\"steps\":%" PRIu32 ",\"result\":%s,\"status\":%d,\"nrc\":%u"
+                     ",\"rtt_us\":%" PRId64 ",\"wait_us\":%" PRId64 ",\"elapsed_us\":%" PRId64 "}",
+                     job->id, job->sequence, state_names[job->state], job->position, job->clients,
+                     job->result.steps, result, job->result.status, job->result.nrc, job->result.rtt_us,
+                     wait_us, elapsed_us);
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+// {"jobs":[...]}, newest first, as many as fit
+static size_t jobs_list_json(char *buf, size_t cap) {
+    diag_job_t snapshot[DIAG_JOBS_MAX];
+    int count = 0;
+    xSemaphoreTake(jobs_lock, portMAX_DELAY);
+    for (int i = 0; i < DIAG_JOBS_MAX; i++) {
+        if (jobs[i].id == 0) {
+            continue;
+        }
+        int at = count++;
+        while (at > 0 && snapshot[at - 1].id < jobs[i].id) {
+            snapshot[at] = snapshot[at - 1];
+            at--;
+        }
+        copy_out(&jobs[i], &snapshot[at]);
+    }
+    xSemaphoreGive(jobs_lock);
+
+    static const char header[] = "{\"jobs\":[";
+    if (cap < sizeof(header) + 2) {
+        return 0;
+    }
+    size_t len = sizeof(header) - 1;
+    memcpy(buf, header, len);
+    for (int i = 0; i < count; i++) {
+        size_t n = diag_jobs_json(buf + len + (i > 0), cap - len - (i > 0) - 3, &snapshot[i]);
+        if (n == 0) {
+            break;
+        }
+        if (i > 0) {
+            buf[len++] = ',';
+        }
+        len += n;
+    }
+    buf[len++] = ']';
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return len;
+}
+
+esp_err_t diag_jobs_respond(httpd_req_t *req, const diag_job_t *job) {
+    char response[320];
+    size_t len = diag_jobs_json(response, sizeof(response), job);
+    httpd_resp_set_status(req, job->state == DIAG_JOB_DONE ? "200 OK" : "202 Accepted");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, response, len);
+}
+
+esp_err_t diag_jobs_submit_and_respond(httpd_req_t *req, const char *sequence) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_DIAG))) {
+        return ESP_OK;
+    }
+    diag_job_t job;
+    esp_err_t err = diag_jobs_submit(sequence, &job);
+    if (err == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_sendstr(req, "Diagnostic queue full");
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid sequence name");
+        return ESP_FAIL;
+    }
+    return diag_jobs_respond(req, &job);
+}
+
+static esp_err_t jobs_post_handler(httpd_req_t *req) {
+    char query[48], name[SEQ_NAME_MAX];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "sequence", name, sizeof(name)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing sequence");
+        return ESP_FAIL;
+    }
+    return diag_jobs_submit_and_respond(req, name);
+}
+
+static esp_err_t jobs_get_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_DIAG))) {
+        return ESP_OK;
+    }
+    char query[32], value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "id", value, sizeof(value)) == ESP_OK) {
+        diag_job_t job;
+        if (!diag_jobs_get((uint32_t)strtoul(value, NULL, 10), &job)) {
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown job");
+            return ESP_FAIL;
+        }
+        return diag_jobs_respond(req, &job);
+    }
+
+    char *response = malloc(DIAG_JOBS_MAX * 320);
+    if (response == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    size_t len = jobs_list_json(response, DIAG_JOBS_MAX * 320);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = httpd_resp_send(req, response, len);
+    free(response);
+    return err;
+}
+
+esp_err_t diag_jobs_start(UBaseType_t priority) {
+    jobs_lock = xSemaphoreCreateMutex();
+    if (jobs_lock == NULL ||
+        xTaskCreate(diag_jobs_task, "diag_task", 4096, NULL, priority, &worker_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    event_source = ws_push_add_event_source(jobs_list_json);
+    return ESP_OK;
+}
+
+esp_err_t diag_jobs_register(httpd_handle_t server) {
+    httpd_uri_t uris[] = {
+        {.uri = "/jobs", .method = HTTP_POST, .handler = jobs_post_handler, .user_ctx = NULL},
+        {.uri = "/jobs", .method = HTTP_GET,  .handler = jobs_get_handler,  .user_ctx = NULL},
+    };
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        esp_err_t err = httpd_register_uri_handler(server, &uris[i]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
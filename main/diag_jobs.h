@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "seq_engine.h"
+
+// Asynchronous execution of diagnostic sequences. Submitting returns a job
+// ID at once; a single worker task runs the jobs in submission order and
+// the HTTP handlers never wait for the bus. A submission for a sequence
+// that is already queued (not yet running) joins that job instead of
+// adding another run. Finished jobs stay readable until their slot is
+// reused by a newer one.
+//
+//   POST /jobs?sequence=<n>    202 with the job, or 503 if the queue is full
+//   GET  /jobs                 recent jobs, newest first
+//   GET  /jobs?id=<id>         one job
+//
+// {"id":7,"sequence":"status_check","state":"running","position":0,"clients":2,
+//  "steps":9,"result":null,"status":0,"nrc":0,"rtt_us":0,"wait_us":120,"elapsed_us":48000}
+//
+// Every state change is also pushed to WebSocket clients as {"jobs":[...]}.
+
+#define DIAG_JOBS_MAX 8
+
+typedef enum {
+    DIAG_JOB_QUEUED,
+    DIAG_JOB_RUNNING,
+    DIAG_JOB_DONE,
+} diag_job_state_t;
+
+typedef struct {
+    uint32_t id;                // 0 for a free slot
+    char sequence[SEQ_NAME_MAX];
+    diag_job_state_t state;
+    uint32_t position;          // jobs ahead of this one, 0 once running
+    uint32_t clients;           // submissions served by this job
+    seq_result_t result;        // steps advance while running, the rest is final once done
+    int64_t queued_us;
+    int64_t start_us;
+    int64_t end_us;
+} diag_job_t;
+
+esp_err_t diag_jobs_start(UBaseType_t priority);
+
+// Queues a run of sequence, or joins a queued one. *job receives a copy.
+// Returns ESP_ERR_INVALID_ARG if seq_name_valid() rejects the name and
+// ESP_ERR_NO_MEM when every slot holds an unfinished job.
+esp_err_t diag_jobs_submit(const char *sequence, diag_job_t *job);
+
+// Withdraws one submission of a queued job, and removes the job if no other
+// client joined it. Returns ESP_ERR_INVALID_STATE if it is already running
+// and ESP_ERR_NOT_FOUND if it is unknown or finished.
+esp_err_t diag_jobs_cancel(uint32_t id);
+
+// Copies the job out. Returns false if it is unknown or was recycled.
+bool diag_jobs_get(uint32_t id, diag_job_t *job);
+
+// True if the job finished, its sequence ran to the end and no request was
+// answered negatively.
+bool diag_jobs_succeeded(const diag_job_t *job);
+
+// Renders one job as JSON. Returns the length, 0 if it does not fit.
+size_t diag_jobs_json(char *buf, size_t cap, const diag_job_t *job);
+
+// Answers an HTTP request with the job: 202 while pending, 200 once done.
+esp_err_t diag_jobs_respond(httpd_req_t *req, const diag_job_t *job);
+
+// Submits and responds, 503 if the queue is full.
+esp_err_t diag_jobs_submit_and_respond(httpd_req_t *req, const char *sequence);
+
+esp_err_t diag_jobs_register(httpd_handle_t server);
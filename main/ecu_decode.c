@@ -0,0 +1,91 @@
+#include "ecu_decode.h"
+
+#include <stdint.h>
+#include "esp_log.h"
+#include "low_latency.h"
+
+static const char *TAG = "ECU_DECODE";
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    int32_t scale_div;
+} ecu_signal_def_t;
+
+static const ecu_signal_def_t signal_defs[ECU_SIGNAL_COUNT] = {
+    [ECU_SIGNAL_STEERING_STATUS]  = {"steering_status", "", 1},
+    [ECU_SIGNAL_STEERING_ANGLE]   = {"steering_angle", "deg", 100},
+    [ECU_SIGNAL_STEERING_RATE]    = {"steering_rate", "deg/s", 100},
+    [ECU_SIGNAL_WHEEL_FL]         = {"wheel_speed_fl", "km/h", 100},
+    [ECU_SIGNAL_WHEEL_FR]         = {"wheel_speed_fr", "km/h", 100},
+    [ECU_SIGNAL_WHEEL_RL]         = {"wheel_speed_rl", "km/h", 100},
+    [ECU_SIGNAL_WHEEL_RR]         = {"wheel_speed_rr", "km/h", 100},
+    [ECU_SIGNAL_GATEWAY_RESPONSE] = {"gateway_response", "", 1},
+    [ECU_SIGNAL_ABS_RESPONSE]     = {"abs_response", "", 1},
+};
+
+esp_err_t ecu_decode_init(void) {
+    for (int i = 0; i < ECU_SIGNAL_COUNT; i++) {
+        const ecu_signal_def_t *d = &signal_defs[i];
+        if (can_signal_define(d->name, d->unit, d->scale_div) != i) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    return ESP_OK;
+}
+
+static inline uint16_t le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// Lenkwinkel_1: 15-bit magnitude plus sign bit, 0.04375 deg per bit
+static inline int32_t sign_magnitude_hundredths(uint16_t raw) {
+    int32_t v = (int32_t)((raw & 0x7FFFu) * 4375u / 1000u);
+    return (raw & 0x8000u) ? -v : v;
+}
+
+// Status reply (23 00 ...): low nibble 0xC of byte 3 means Status 4
+LOW_LATENCY_IRAM void ecu_decode_status(can_record_t *rec, void *ctx) {
+    int status = (rec->data[3] & 0x0F) == 0x0C ? 4 : 3;
+    ESP_LOGI(TAG, "Status %d detected (0x%02X)", status, rec->data[3]);
+    rec->status = (uint8_t)status;
+    can_signal_set(ECU_SIGNAL_STEERING_STATUS, status, rec->timestamp_us);
+}
+
+LOW_LATENCY_IRAM void ecu_decode_steering_angle(can_record_t *rec, void *ctx) {
+    if (rec->dlc < 4) {
+        return;
+    }
+    can_signal_set(ECU_SIGNAL_STEERING_ANGLE, sign_magnitude_hundredths(le16(&rec->data[0])), rec->timestamp_us);
+    can_signal_set(ECU_SIGNAL_STEERING_RATE, sign_magnitude_hundredths(le16(&rec->data[2])), rec->timestamp_us);
+}
+
+// Bremse_3: four 16-bit words, bit 0 is the direction flag and the rest is
+// the speed in 0.01 km/h
+LOW_LATENCY_IRAM void ecu_decode_wheel_speeds(can_record_t *rec, void *ctx) {
+    if (rec->dlc < 8) {
+        return;
+    }
+    for (int w = 0; w < 4; w++) {
+        can_signal_set(ECU_SIGNAL_WHEEL_FL + w, le16(&rec->data[2 * w]) >> 1, rec->timestamp_us);
+    }
+}
+
+// Single and first frames of a diagnostic response: records the service
+// answered, or 0x7F00 | NRC for a negative response.
+LOW_LATENCY_IRAM void ecu_decode_uds_response(can_record_t *rec, void *ctx) {
+    uint8_t pci = rec->data[0] >> 4;
+    const uint8_t *payload;
+    if (pci == 0 && rec->dlc >= 2) {
+        payload = &rec->data[1];
+    } else if (pci == 1 && rec->dlc >= 3) {
+        payload = &rec->data[2];
+    } else {
+        return;
+    }
+    int32_t value = payload[0];
+    if (payload[0] == 0x7F && payload + 2 < rec->data + rec->dlc) {
+        value = 0x7F00 | payload[2];
+    }
+    can_signal_set((int)(intptr_t)ctx, value, rec->timestamp_us);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "esp_err.h"
+#include "can_dispatch.h"
+
+// Decoders for the frames the firmware monitors, and the signals they
+// publish. Identifiers and scaling follow the PQ-platform CAN matrix the
+// steering ECU belongs to; other platforms only need a different handler
+// table in rx_path.c and, where the layout differs, another decoder here.
+
+#define ECU_STEERING_ANGLE_ID   0x0C2   // Lenkwinkel_1, 100 Hz broadcast
+#define ECU_WHEEL_SPEED_ID      0x4A0   // Bremse_3 (ABS), 100 Hz broadcast
+#define ECU_GATEWAY_DIAG_RX_ID  0x77A   // gateway diagnostic responses
+#define ECU_ABS_DIAG_RX_ID      0x77D   // ABS diagnostic responses
+
+// Signal indices in the cache, defined in this order by ecu_decode_init()
+typedef enum {
+    ECU_SIGNAL_STEERING_STATUS,     // 3 or 4, from the 0x762 status reply
+    ECU_SIGNAL_STEERING_ANGLE,      // hundredths of a degree, signed
+    ECU_SIGNAL_STEERING_RATE,       // hundredths of a degree per second
+    ECU_SIGNAL_WHEEL_FL,            // hundredths of km/h
+    ECU_SIGNAL_WHEEL_FR,
+    ECU_SIGNAL_WHEEL_RL,
+    ECU_SIGNAL_WHEEL_RR,
+    ECU_SIGNAL_GATEWAY_RESPONSE,    // last service ID answered, NRC as 0x7F00 | code
+    ECU_SIGNAL_ABS_RESPONSE,
+    ECU_SIGNAL_COUNT
+} ecu_signal_t;
+
+esp_err_t ecu_decode_init(void);
+
+// can_decoder_t callbacks. The UDS one takes the ecu_signal_t to update as
+// ctx, cast with (void *)(intptr_t).
+void ecu_decode_status(can_record_t *rec, void *ctx);
+void ecu_decode_steering_angle(can_record_t *rec, void *ctx);
+void ecu_decode_wheel_speeds(can_record_t *rec, void *ctx);
+void ecu_decode_uds_response(can_record_t *rec, void *ctx);
@@ -0,0 +1,65 @@
+#include "frame_json.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+size_t frame_json_record(char *buf, size_t cap, const can_record_t *rec) {
+    char data[3 * 8];
+    size_t d = 0;
+    for (int i = 0; i < rec->dlc && i < 8; i++) {
+        if (i > 0) {
+            data[d++] = ' ';
+        }
+        data[d++] = hex_digits[rec->data[i] >> 4];
+        data[d++] = hex_digits[rec->data[i] & 0x0F];
+    }
+    data[d] = '\0';
+
+    int n = snprintf(buf, cap, "{\"seq\":%" PRIu32 ",\"t\":%" PRId64 ",\"id\":%u,\"data\":\"%s\",\"status\":%u}",
+                     rec->seq, rec->timestamp_us, rec->identifier, data, rec->status);
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+size_t frame_json_list(char *buf, size_t cap, const can_record_t *recs, size_t count, uint32_t *next_seq) {
+    // Room for the header with a 10-digit seq and the closing "]}"
+    const size_t header_max = sizeof("{\"next\":4294967295,\"frames\":[") - 1;
+    const size_t footer = 2;
+    if (cap < header_max + footer + 1) {
+        return 0;
+    }
+
+    // Records go first, starting after the largest possible header, so the
+    // header can report where rendering actually stopped.
+    char *p = buf + header_max;
+    size_t left = cap - header_max - footer;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        size_t n = frame_json_record(p + (i > 0), left - (i > 0), &recs[i]);
+        if (n == 0) {
+            break;
+        }
+        if (i > 0) {
+            *p = ',';
+            n++;
+        }
+        p += n;
+        left -= n;
+    }
+    if (i < count) {
+        *next_seq = recs[i].seq;
+    }
+
+    char header[header_max + 1];
+    int h = snprintf(header, sizeof(header), "{\"next\":%" PRIu32 ",\"frames\":[", *next_seq);
+    size_t body = (size_t)(p - (buf + header_max));
+    memmove(buf + h, buf + header_max, body);
+    memcpy(buf, header, (size_t)h);
+    p = buf + h + body;
+    *p++ = ']';
+    *p++ = '}';
+    *p = '\0';
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "rx_ring.h"
+
+// Compact JSON rendering of received frames for the HTTP endpoints:
+// {"seq":12,"t":1234567,"id":1890,"data":"23 00 8C ...","status":4}
+// Output is bounded by cap and never truncated mid-record.
+
+// Writes one record. Returns the length written, or 0 if it does not fit.
+size_t frame_json_record(char *buf, size_t cap, const can_record_t *rec);
+
+// Writes {"next":N,"frames":[...]} with as many records as fit. *next_seq
+// is the sequence number following the records passed in; if some did not
+// fit it is moved back to the first one left out. Either way N is where the
+// reader should continue.
+size_t frame_json_list(char *buf, size_t cap, const can_record_t *recs, size_t count, uint32_t *next_seq);
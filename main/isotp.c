@@ -0,0 +1,249 @@
+#include "isotp.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "metrics.h"
+#include "low_latency.h"
+
+static const char *TAG = "ISOTP";
+
+#define PCI_SINGLE      0x0
+#define PCI_FIRST       0x1
+#define PCI_CONSECUTIVE 0x2
+#define PCI_FLOW        0x3
+
+#define FC_CTS          0x0
+#define FC_WAIT         0x1
+#define FC_OVERFLOW     0x2
+
+#define MAX_FC_WAITS    10  // N_WFTmax
+
+esp_err_t isotp_init(isotp_link_t *link, const isotp_config_t *cfg) {
+    link->cfg = *cfg;
+    link->rx_dropped = 0;
+    link->tx_done_us = 0;
+    link->rx_start_us = 0;
+    link->rx_queue = xQueueCreate(ISOTP_RX_QUEUE_LEN, sizeof(can_record_t));
+    link->lock = xSemaphoreCreateMutex();
+    if (link->rx_queue == NULL || link->lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+LOW_LATENCY_IRAM void isotp_on_frame(isotp_link_t *link, const can_record_t *rec) {
+    if (rec->identifier != link->cfg.rx_id || rec->dlc == 0) {
+        return;
+    }
+    if (xQueueSend(link->rx_queue, rec, 0) != pdTRUE) {
+        link->rx_dropped++;
+    }
+    metrics_max(METRIC_ISOTP_QUEUE_HWM, uxQueueMessagesWaiting(link->rx_queue));
+}
+
+bool isotp_lock(isotp_link_t *link, uint32_t timeout_ms) {
+    return xSemaphoreTake(link->lock, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+void isotp_unlock(isotp_link_t *link) {
+    xSemaphoreGive(link->lock);
+}
+
+static void build_frame(isotp_link_t *link, tx_frame_t *frame, const uint8_t *bytes, size_t len) {
+    frame->identifier = link->cfg.tx_id;
+    frame->dlc = 8;
+    frame->delay_us = 0;
+    memset(frame->data, link->cfg.padding, sizeof(frame->data));
+    memcpy(frame->data, bytes, len);
+}
+
+static esp_err_t transmit(isotp_link_t *link, const tx_frame_t *frames, size_t count) {
+    tx_result_t result;
+    esp_err_t err = link->cfg.transmit(frames, count, &result);
+    if (err == ESP_OK) {
+        link->tx_done_us = result.end_us;
+    }
+    return err;
+}
+
+static esp_err_t send_frame(isotp_link_t *link, const uint8_t *bytes, size_t len) {
+    tx_frame_t frame;
+    build_frame(link, &frame, bytes, len);
+    return transmit(link, &frame, 1);
+}
+
+static bool next_frame(isotp_link_t *link, can_record_t *rec, uint32_t timeout_ms) {
+    return xQueueReceive(link->rx_queue, rec, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+static uint32_t st_min_to_us(uint8_t st_min) {
+    if (st_min <= 0x7F) {
+        return (uint32_t)st_min * 1000;
+    }
+    if (st_min >= 0xF1 && st_min <= 0xF9) {
+        return (uint32_t)(st_min - 0xF0) * 100;
+    }
+    return 127000; // reserved values: use the longest valid separation
+}
+
+static esp_err_t wait_flow_control(isotp_link_t *link, uint8_t *bs, uint32_t *st_min_us) {
+    can_record_t rec;
+    int waits = 0;
+    while (next_frame(link, &rec, link->cfg.timeout_ms)) {
+        if ((rec.data[0] >> 4) != PCI_FLOW || rec.dlc < 3) {
+            continue;
+        }
+        switch (rec.data[0] & 0x0F) {
+        case FC_CTS:
+            *bs = rec.data[1];
+            *st_min_us = st_min_to_us(rec.data[2]);
+            return ESP_OK;
+        case FC_WAIT:
+            if (++waits > MAX_FC_WAITS) {
+                ESP_LOGW(TAG, "Peer sent too many FC.WAIT frames");
+                return ESP_ERR_TIMEOUT;
+            }
+            break;
+        case FC_OVERFLOW:
+            ESP_LOGW(TAG, "Peer reported buffer overflow");
+            return ESP_ERR_INVALID_SIZE;
+        default:
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t isotp_send(isotp_link_t *link, const uint8_t *payload, size_t len) {
+    uint8_t frame[8];
+
+    if (len == 0 || len > ISOTP_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (len <= 7) {
+        frame[0] = (PCI_SINGLE << 4) | (uint8_t)len;
+        memcpy(&frame[1], payload, len);
+        return send_frame(link, frame, len + 1);
+    }
+
+    frame[0] = (PCI_FIRST << 4) | (uint8_t)(len >> 8);
+    frame[1] = (uint8_t)len;
+    memcpy(&frame[2], payload, 6);
+    esp_err_t err = send_frame(link, frame, 8);
+    size_t sent = 6;
+    uint8_t sn = 1;
+
+    while (err == ESP_OK && sent < len) {
+        uint8_t bs;
+        uint32_t st_min_us;
+        err = wait_flow_control(link, &bs, &st_min_us);
+        if (err != ESP_OK) {
+            break;
+        }
+
+        tx_frame_t batch[ISOTP_TX_BATCH];
+        unsigned block = 0;
+        while (err == ESP_OK && sent < len && (bs == 0 || block < bs)) {
+            size_t count = 0;
+            for (; count < ISOTP_TX_BATCH && sent < len && (bs == 0 || block < bs); count++, block++) {
+                size_t n = len - sent < 7 ? len - sent : 7;
+                uint8_t cf[8];
+                cf[0] = (PCI_CONSECUTIVE << 4) | sn;
+                memcpy(&cf[1], payload + sent, n);
+                build_frame(link, &batch[count], cf, n + 1);
+                // STmin separates consecutive frames; the first CF after a
+                // flow control frame may go out immediately.
+                batch[count].delay_us = block > 0 ? st_min_us : 0;
+                sent += n;
+                sn = (sn + 1) & 0x0F;
+            }
+            err = transmit(link, batch, count);
+        }
+    }
+    return err;
+}
+
+static esp_err_t send_flow_control(isotp_link_t *link, uint8_t status) {
+    uint8_t fc[3] = {(PCI_FLOW << 4) | status, link->cfg.block_size, link->cfg.st_min};
+    return send_frame(link, fc, sizeof(fc));
+}
+
+esp_err_t isotp_receive(isotp_link_t *link, uint8_t *buf, size_t cap, size_t *len, uint32_t timeout_ms) {
+    can_record_t rec;
+    size_t total;
+
+    // Wait for the start of a message; stray CF/FC frames are skipped.
+    for (;;) {
+        if (!next_frame(link, &rec, timeout_ms)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        uint8_t pci = rec.data[0] >> 4;
+        if (pci == PCI_SINGLE || pci == PCI_FIRST) {
+            link->rx_start_us = rec.timestamp_us;
+        }
+        if (pci == PCI_SINGLE) {
+            size_t n = rec.data[0] & 0x0F;
+            if (n == 0 || n > 7 || n + 1 > rec.dlc) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            if (n > cap) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(buf, &rec.data[1], n);
+            *len = n;
+            return ESP_OK;
+        }
+        if (pci == PCI_FIRST) {
+            break;
+        }
+    }
+
+    total = ((size_t)(rec.data[0] & 0x0F) << 8) | rec.data[1];
+    if (total < 8 || rec.dlc < 8) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (total > cap) {
+        send_flow_control(link, FC_OVERFLOW);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(buf, &rec.data[2], 6);
+    size_t got = 6;
+    uint8_t sn = 1;
+
+    while (got < total) {
+        esp_err_t err = send_flow_control(link, FC_CTS);
+        if (err != ESP_OK) {
+            return err;
+        }
+        for (unsigned block = 0; got < total && (link->cfg.block_size == 0 || block < link->cfg.block_size); block++) {
+            if (!next_frame(link, &rec, link->cfg.timeout_ms)) {
+                ESP_LOGW(TAG, "Timeout waiting for CF %u (%u/%u bytes)", sn, (unsigned)got, (unsigned)total);
+                return ESP_ERR_TIMEOUT;
+            }
+            if ((rec.data[0] >> 4) != PCI_CONSECUTIVE || (rec.data[0] & 0x0F) != sn) {
+                ESP_LOGW(TAG, "Unexpected frame 0x%02X, expected CF %u", rec.data[0], sn);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            size_t n = total - got < 7 ? total - got : 7;
+            if (n + 1 > rec.dlc) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            memcpy(buf + got, &rec.data[1], n);
+            got += n;
+            sn = (sn + 1) & 0x0F;
+        }
+    }
+
+    *len = total;
+    return ESP_OK;
+}
+
+esp_err_t isotp_request(isotp_link_t *link, const uint8_t *req, size_t req_len,
+                        uint8_t *resp, size_t resp_cap, size_t *resp_len, uint32_t timeout_ms) {
+    xQueueReset(link->rx_queue);
+    esp_err_t err = isotp_send(link, req, req_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return isotp_receive(link, resp, resp_cap, resp_len, timeout_ms);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "rx_ring.h"
+#include "twai_tx.h"
+
+// ISO 15765-2 (ISO-TP) transport over a pair of 11-bit identifiers, normal
+// addressing. Frames from the peer are fed in by twai_receive_task through
+// isotp_on_frame(); segmentation, reassembly and flow control run in the
+// calling task.
+
+#define ISOTP_MAX_PAYLOAD   4095
+#define ISOTP_RX_QUEUE_LEN  32
+#define ISOTP_TX_BATCH      16  // consecutive frames handed to the transmitter at once
+
+// Sends the frames in order, waiting at least delay_us before each one.
+typedef esp_err_t (*isotp_transmit_fn)(const tx_frame_t *frames, size_t count, tx_result_t *result);
+
+typedef struct {
+    uint32_t tx_id;
+    uint32_t rx_id;
+    uint8_t block_size;         // BS we advertise in flow control, 0 = unlimited
+    uint8_t st_min;             // STmin we advertise, raw ISO-TP encoding
+    uint8_t padding;            // filler for unused bytes of short frames
+    uint32_t timeout_ms;        // N_Bs / N_Cr: max wait for the peer's next frame
+    isotp_transmit_fn transmit;
+} isotp_config_t;
+
+typedef struct {
+    isotp_config_t cfg;
+    QueueHandle_t rx_queue;
+    SemaphoreHandle_t lock;
+    volatile uint32_t rx_dropped;
+    int64_t tx_done_us;         // last frame of the latest message sent
+    int64_t rx_start_us;        // first frame of the latest message received
+} isotp_link_t;
+
+esp_err_t isotp_init(isotp_link_t *link, const isotp_config_t *cfg);
+
+// RX task hook: queues frames addressed to this link, drops the rest.
+void isotp_on_frame(isotp_link_t *link, const can_record_t *rec);
+
+// Exclusive use of the link for a request and every response it triggers.
+bool isotp_lock(isotp_link_t *link, uint32_t timeout_ms);
+void isotp_unlock(isotp_link_t *link);
+
+// Sends one message, segmenting it and honouring the peer's BS and STmin.
+// Each block of consecutive frames goes to the transmitter as one batch
+// with STmin as the per-frame gap.
+esp_err_t isotp_send(isotp_link_t *link, const uint8_t *payload, size_t len);
+
+// Receives one message, sending flow control for multi-frame transfers.
+esp_err_t isotp_receive(isotp_link_t *link, uint8_t *buf, size_t cap, size_t *len, uint32_t timeout_ms);
+
+// Discards stale frames, sends the request and waits for the response.
+// The caller must hold the link lock.
+esp_err_t isotp_request(isotp_link_t *link, const uint8_t *req, size_t req_len,
+                        uint8_t *resp, size_t resp_cap, size_t *resp_len, uint32_t timeout_ms);
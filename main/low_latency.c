@@ -0,0 +1,277 @@
+#include "low_latency.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#define PM_LOCKS true
+#else
+#define PM_LOCKS false
+#endif
+#include "metrics.h"
+
+// With CONFIG_PM_ENABLE the CPU drops to this frequency when idle and no
+// lock is held. The TWAI driver keeps APB at 80 MHz while it is installed.
+#define IDLE_CPU_FREQ_MHZ 80
+
+static const char *TAG = "LOW_LATENCY";
+
+static SemaphoreHandle_t mode_lock;
+static bool enabled = LOW_LATENCY_MODE;
+static int holders;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t cpu_lock;       // CPU (and with it APB) at maximum frequency
+static esp_pm_lock_handle_t sleep_lock;     // no light sleep
+#endif
+
+static const low_latency_task_t *tasks;
+static size_t task_count;
+
+// Lateness since the last mode switch, log2 buckets as in metrics.h.
+typedef struct {
+    uint32_t buckets[METRIC_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+} probe_stats_t;
+
+static TaskHandle_t probe_task_handle;
+static esp_timer_handle_t probe_timer;
+static probe_stats_t probe_stats;      // probe task wake-ups
+static probe_stats_t send_stats;       // sequence sends after a delay
+static portMUX_TYPE probe_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void hold_locks(bool hold) {
+#if CONFIG_PM_ENABLE
+    if (hold) {
+        esp_pm_lock_acquire(cpu_lock);
+        esp_pm_lock_acquire(sleep_lock);
+    } else {
+        esp_pm_lock_release(sleep_lock);
+        esp_pm_lock_release(cpu_lock);
+    }
+#endif
+}
+
+void low_latency_acquire(void) {
+    xSemaphoreTake(mode_lock, portMAX_DELAY);
+    if (holders++ == 0 && enabled) {
+        hold_locks(true);
+    }
+    xSemaphoreGive(mode_lock);
+}
+
+void low_latency_release(void) {
+    xSemaphoreTake(mode_lock, portMAX_DELAY);
+    if (--holders == 0 && enabled) {
+        hold_locks(false);
+    }
+    xSemaphoreGive(mode_lock);
+}
+
+bool low_latency_enabled(void) {
+    return enabled;
+}
+
+// Called with mode_lock held.
+static void apply_priorities(void) {
+    for (size_t i = 0; i < task_count; i++) {
+        TaskHandle_t task = xTaskGetHandle(tasks[i].name);
+        if (task == NULL) {
+            ESP_LOGW(TAG, "No task %s", tasks[i].name);
+            continue;
+        }
+        vTaskPrioritySet(task, enabled ? tasks[i].fast_priority : tasks[i].priority);
+    }
+    if (probe_task_handle != NULL) {
+        vTaskPrioritySet(probe_task_handle, enabled ? tasks[0].fast_priority : tasks[0].priority);
+    }
+}
+
+esp_err_t low_latency_set(bool on) {
+    xSemaphoreTake(mode_lock, portMAX_DELAY);
+    if (on != enabled && holders > 0) {
+        hold_locks(on);
+    }
+    enabled = on;
+    apply_priorities();
+    xSemaphoreGive(mode_lock);
+    metrics_set(METRIC_LOW_LATENCY_MODE, on);
+
+    portENTER_CRITICAL(&probe_stats_lock);
+    memset(&probe_stats, 0, sizeof(probe_stats));
+    memset(&send_stats, 0, sizeof(send_stats));
+    portEXIT_CRITICAL(&probe_stats_lock);
+    ESP_LOGI(TAG, "Low-latency mode %s", on ? "on" : "off");
+    return ESP_OK;
+}
+
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+static void IRAM_ATTR probe_timer_callback(void *arg) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(probe_task_handle, &woken);
+    if (woken) {
+        esp_timer_isr_dispatch_need_yield();
+    }
+}
+#define PROBE_TIMER_DISPATCH ESP_TIMER_ISR
+#else
+static void probe_timer_callback(void *arg) {
+    xTaskNotifyGive(probe_task_handle);
+}
+#define PROBE_TIMER_DISPATCH ESP_TIMER_TASK
+#endif
+
+static void stats_add(probe_stats_t *s, int64_t late_us) {
+    uint32_t v = late_us <= 0 ? 0 : late_us > UINT32_MAX ? UINT32_MAX : (uint32_t)late_us;
+    unsigned b = v <= 1 ? 0 : 32 - __builtin_clz(v - 1);
+    portENTER_CRITICAL(&probe_stats_lock);
+    s->buckets[b < METRIC_HIST_BUCKETS ? b : METRIC_HIST_BUCKETS - 1]++;
+    s->count++;
+    s->sum_us += v;
+    if (v > s->max_us) {
+        s->max_us = v;
+    }
+    portEXIT_CRITICAL(&probe_stats_lock);
+}
+
+static void probe_task(void *pvParameters) {
+    while (1) {
+        int64_t deadline_us = esp_timer_get_time() + LOW_LATENCY_PROBE_PERIOD_US;
+        esp_timer_start_once(probe_timer, LOW_LATENCY_PROBE_PERIOD_US);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t late_us = esp_timer_get_time() - deadline_us;
+        metrics_observe(METRIC_HIST_WAKE_LATENCY, late_us);
+        stats_add(&probe_stats, late_us);
+    }
+}
+
+void low_latency_observe_send(int64_t late_us) {
+    metrics_observe(METRIC_HIST_SEQ_SEND_LATE, late_us);
+    stats_add(&send_stats, late_us);
+}
+
+esp_err_t low_latency_init(void) {
+    mode_lock = xSemaphoreCreateMutex();
+    if (mode_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = IDLE_CPU_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "low_latency", &cpu_lock);
+    }
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "low_latency", &sleep_lock);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+#endif
+    metrics_set(METRIC_LOW_LATENCY_MODE, enabled);
+    return ESP_OK;
+}
+
+esp_err_t low_latency_start(const low_latency_task_t *task_table, size_t count) {
+    if (count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tasks = task_table;
+    task_count = count;
+
+    esp_timer_create_args_t args = {
+        .callback = &probe_timer_callback,
+        .dispatch_method = PROBE_TIMER_DISPATCH,
+        .name = "latency_probe"
+    };
+    esp_err_t err = esp_timer_create(&args, &probe_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (xTaskCreate(probe_task, "latency_probe", 2048, NULL,
+                    enabled ? tasks[0].fast_priority : tasks[0].priority, &probe_task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return low_latency_set(enabled);
+}
+
+// Upper bound of the bucket holding the given fraction of the samples.
+static uint32_t percentile_us(const probe_stats_t *s, uint32_t permille) {
+    uint32_t target = (uint32_t)(((uint64_t)s->count * permille + 999) / 1000);
+    uint32_t cumulative = 0;
+    for (int b = 0; b < METRIC_HIST_BUCKETS; b++) {
+        cumulative += s->buckets[b];
+        if (cumulative >= target) {
+            return b < METRIC_HIST_BUCKETS - 1 && (1u << b) < s->max_us ? 1u << b : s->max_us;
+        }
+    }
+    return s->max_us;
+}
+
+// "samples":...,"max_us":... without the braces
+static int stats_json(char *buf, size_t cap, const probe_stats_t *s) {
+    return snprintf(buf, cap,
+                    "\"samples\":%" PRIu32 ",\"mean_us\":%" PRIu32 ",\"p50_us\":%" PRIu32 ",\"p99_us\":%" PRIu32
+                    ",\"max_us\":%" PRIu32,
+                    s->count, s->count > 0 ? (uint32_t)(s->sum_us / s->count) : 0, percentile_us(s, 500),
+                    percentile_us(s, 990), s->max_us);
+}
+
+static esp_err_t latency_get_handler(httpd_req_t *req) {
+    probe_stats_t probe, send;
+    portENTER_CRITICAL(&probe_stats_lock);
+    probe = probe_stats;
+    send = send_stats;
+    portEXIT_CRITICAL(&probe_stats_lock);
+
+    char response[384];
+    int len = snprintf(response, sizeof(response),
+                       "{\"mode\":\"%s\",\"pm_locks\":%s,\"holders\":%d,\"probe_period_us\":%d,",
+                       enabled ? "on" : "off", PM_LOCKS ? "true" : "false", holders, LOW_LATENCY_PROBE_PERIOD_US);
+    len += stats_json(response + len, sizeof(response) - len, &probe);
+    len += snprintf(response + len, sizeof(response) - len, ",\"send\":{");
+    len += stats_json(response + len, sizeof(response) - len, &send);
+    snprintf(response + len, sizeof(response) - len, "}}");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t latency_post_handler(httpd_req_t *req) {
+    char query[24], mode[4];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "mode", mode, sizeof(mode)) != ESP_OK ||
+        (strcmp(mode, "on") != 0 && strcmp(mode, "off") != 0)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected mode=on|off");
+        return ESP_FAIL;
+    }
+    low_latency_set(strcmp(mode, "on") == 0);
+    return latency_get_handler(req);
+}
+
+esp_err_t low_latency_register(httpd_handle_t server) {
+    httpd_uri_t uris[] = {
+        {.uri = "/latency", .method = HTTP_GET,  .handler = latency_get_handler,  .user_ctx = NULL},
+        {.uri = "/latency", .method = HTTP_POST, .handler = latency_post_handler, .user_ctx = NULL},
+    };
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        esp_err_t err = httpd_register_uri_handler(server, &uris[i]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+
+// Low-latency mode for the CAN path. While it is on:
+//
+//   - diagnostic sequences and calibration hold power management locks, so
+//     dynamic frequency scaling and light sleep cannot add wake-up jitter
+//     (only relevant with CONFIG_PM_ENABLE)
+//   - the RX, TX and recovery tasks and the sequence executor run above
+//     lwIP's tcpip task, still below the Wi-Fi task
+//
+// Wi-Fi power save is not part of it: the device is a SoftAP, and modem
+// sleep (esp_wifi_set_ps) only applies to stations.
+//
+// The mode can be switched at run time to compare both on one build. A
+// probe task at the RX task's priority is woken every
+// LOW_LATENCY_PROBE_PERIOD_US by an ISR-dispatched timer; the delay from
+// the timer deadline to the task running, the same path a received frame
+// takes from the TWAI ISR to the RX task, goes to the can_wake_latency_us
+// histogram on /metrics. The sequence executor reports how late each send
+// that follows a delay step reaches the driver, which adds its own wake-up,
+// spin and the hand-over to the TX task (seq_send_late_us).
+//
+//   GET  /latency              mode and wake latency since the last switch
+//   POST /latency?mode=on|off
+
+// Build with -DLOW_LATENCY_MODE=0 to start in normal mode and keep the RX
+// hot path in flash.
+#ifndef LOW_LATENCY_MODE
+#define LOW_LATENCY_MODE 1
+#endif
+
+// Functions on the RX path, from the backend receive to the consumers,
+// and the data they read. Executed from IRAM so a flash cache miss cannot
+// stall a frame.
+#if LOW_LATENCY_MODE
+#define LOW_LATENCY_IRAM IRAM_ATTR
+#define LOW_LATENCY_DRAM DRAM_ATTR
+#else
+#define LOW_LATENCY_IRAM
+#define LOW_LATENCY_DRAM
+#endif
+
+#define LOW_LATENCY_PROBE_PERIOD_US 5000
+
+// A task whose priority follows the mode, looked up by name.
+typedef struct {
+    const char *name;
+    UBaseType_t priority;           // normal mode
+    UBaseType_t fast_priority;      // low-latency mode
+} low_latency_task_t;
+
+// Configures power management and creates the locks. Call before anything
+// acquires them.
+esp_err_t low_latency_init(void);
+
+// Applies the initial mode to tasks, which must already exist, and starts
+// the probe at the priorities of tasks[0] (the RX task). The table must
+// stay valid.
+esp_err_t low_latency_start(const low_latency_task_t *tasks, size_t count);
+
+esp_err_t low_latency_set(bool enabled);
+bool low_latency_enabled(void);
+
+// Records how late a timed sequence send reached the driver.
+void low_latency_observe_send(int64_t late_us);
+
+// Brackets latency-critical work (a sequence, a calibration). Calls nest;
+// the locks are held from the first acquire to the last release.
+void low_latency_acquire(void);
+void low_latency_release(void);
+
+esp_err_t low_latency_register(httpd_handle_t server);
@@ -1,164 +1,159 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
-#include "driver/gpio.h"
-#include "driver/twai.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
+#if !CONFIG_IDF_TARGET_LINUX
 #include "esp_wifi.h"
 #include "esp_event.h"
+#endif
 #include "nvs_flash.h"
 #include "esp_http_server.h"
 #include "esp_timer.h"
+#include "esp_task.h"
 #include <inttypes.h>
+#include "bus_recovery.h"
+#include "can_backend.h"
+#include "can_filter.h"
+#include "can_dispatch.h"
+#include "ecu_decode.h"
+#include "rx_ring.h"
+#include "rx_path.h"
+#include "resp_match.h"
+#include "isotp.h"
+#include "twai_tx.h"
+#include "frame_json.h"
+#include "web_static.h"
+#include "ws_push.h"
+#include "capture.h"
+#include "metrics.h"
+#include "seq_engine.h"
+#include "diag_jobs.h"
+#include "low_latency.h"
+#include "calibration.h"
+#include "boot.h"
 
 #define TX_GPIO_NUM 18
 #define RX_GPIO_NUM 19
+#define CAN_IFNAME "vcan0"  // SocketCAN interface for the linux target
+#define CAN_BITRATE 500000
 
 #define WIFI_SSID "ESP32_AP"
 #define WIFI_PASS ""
 
-#define MAX_STORED_MESSAGES 20 //20
+#define MAX_DISPLAYED_MESSAGES 20 // frames returned per /messages request
 
+#define BUS_RECOVERY_TASK_PRIO 10
 #define TWAI_TX_TASK_PRIO 9
 #define TWAI_RX_TASK_PRIO 8
-#define EXAMPLE_DELAY_BETWEEN_MSGS_MS 500 //100
-#define MAX_RETRIES 3
+#define DIAG_TASK_PRIO 6
+#define NET_INIT_TASK_PRIO 5
+#define WS_PUSH_TASK_PRIO 4
+#define CAPTURE_TASK_PRIO 2
+
+// Low-latency mode (low_latency.h) lifts the CAN tasks and the sequence
+// executor above lwIP's tcpip task, keeping them below the Wi-Fi task. The
+// executor stays below the RX task, which its spin before a timed step
+// must not hold up.
+#define BUS_RECOVERY_TASK_PRIO_FAST (ESP_TASK_TCPIP_PRIO + 4)
+#define TWAI_TX_TASK_PRIO_FAST (ESP_TASK_TCPIP_PRIO + 3)
+#define TWAI_RX_TASK_PRIO_FAST (ESP_TASK_TCPIP_PRIO + 2)
+#define DIAG_TASK_PRIO_FAST (ESP_TASK_TCPIP_PRIO + 1)
+
+#define DIAG_FRAME_TIMEOUT_MS 1000      // N_Bs / N_Cr between frames of one message
 
 static const char *TAG = "TWAI_APP";
 
-QueueHandle_t message_queue;
-
-typedef struct {
-    twai_message_t message;
-    const char* status;
-} message_with_status_t;
-
-message_with_status_t stored_messages[MAX_STORED_MESSAGES];
-int stored_message_count = 0;
-
-twai_message_t angle_config_messages[] = {
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x03, 0x14, 0xFF, 0x00, 0xB6, 0x01, 0xFF, 0xFF}},
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x03, 0x31, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00}},
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x03, 0x31, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00}}
-};
-
-twai_message_t status_check_messages[] = {
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x02, 0x10, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00}},
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x02, 0x21, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00}},
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x02, 0x21, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00}},
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x02, 0x21, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00}},
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x02, 0x21, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00}},
-    {.identifier = 0x742, .data_length_code = 8, .data = {0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}
+static rx_ring_slot_t rx_ring_storage[RX_RING_CAPACITY];
+static rx_ring_t rx_ring;
+
+// Build with -DCAPTURE_ACCEPT_ALL=1 to open the acceptance filter so the
+// capture log sees the whole bus; rx_handlers (rx_path.c) are then applied
+// in software.
+#ifndef CAPTURE_ACCEPT_ALL
+#define CAPTURE_ACCEPT_ALL 0
+#endif
+
+// Driver RX queue (TWAI). The ISR keeps filling it from IRAM while a flash
+// sector erase by the capture writer stalls the RX task. Without
+// CONFIG_SPI_FLASH_AUTO_SUSPEND the scheduler is suspended for the whole
+// erase: typically 45 ms, several hundred in the worst case. With it (set in
+// sdkconfig.defaults) the erase yields to the CPU and the stall is short.
+// The queue holds a full bus for the longest stall.
+#define BUS_MAX_FRAMES_PER_S 4500   // 500 kbit/s, back-to-back 8-byte frames
+#if CONFIG_SPI_FLASH_AUTO_SUSPEND
+#define RX_STALL_MAX_MS 50
+#else
+#define RX_STALL_MAX_MS 400         // sector erase, worst case of common flash chips
+#endif
+#define TWAI_RX_QUEUE_LEN (BUS_MAX_FRAMES_PER_S * RX_STALL_MAX_MS / 1000)
+#define RX_ERROR_BACKOFF_MS 10
+
+static can_hw_filter_t rx_hw_filter;
+
+// The RX task comes first: the latency probe runs at its priority.
+static const low_latency_task_t latency_tasks[] = {
+    {"TWAI_receive_task", TWAI_RX_TASK_PRIO, TWAI_RX_TASK_PRIO_FAST},
+    {"TWAI_tx_task", TWAI_TX_TASK_PRIO, TWAI_TX_TASK_PRIO_FAST},
+    {"bus_recovery", BUS_RECOVERY_TASK_PRIO, BUS_RECOVERY_TASK_PRIO_FAST},
+    {"diag_task", DIAG_TASK_PRIO, DIAG_TASK_PRIO_FAST},
 };
 
-static esp_timer_handle_t countdown_timer;
-static int countdown_value = 10;
-static bool countdown_active = false;
-static bool timer_created = false;
-static int current_status = 3; // 3: Status 3, 4: Status 4
-
-void send_twai_messages(twai_message_t* messages, int count) {
-    for (int i = 0; i < count; i++) {
-        int retries = 0;
-        esp_err_t result;
-        do {
-            result = twai_transmit(&messages[i], pdMS_TO_TICKS(1000));
-            if (result == ESP_OK) {
-                ESP_LOGI(TAG, "Message %d successfully sent: ID=0x%03" PRIx32 ", DLC=%d", i + 1, messages[i].identifier, messages[i].data_length_code);
-                break;
-            } else {
-                ESP_LOGE(TAG, "Failed to send message %d, error: %s. Retry %d", i + 1, esp_err_to_name(result), retries + 1);
-                retries++;
-                
-                twai_status_info_t status;
-                twai_get_status_info(&status);
-                ESP_LOGI(TAG, "TWAI status: state=%lu, msgs_to_tx=%lu, msgs_to_rx=%lu, tx_error_counter=%lu, rx_error_counter=%lu",
-                         (unsigned long)status.state, (unsigned long)status.msgs_to_tx, (unsigned long)status.msgs_to_rx,
-                         (unsigned long)status.tx_error_counter, (unsigned long)status.rx_error_counter);
-
-                if (status.state == TWAI_STATE_BUS_OFF) {
-                    ESP_LOGI(TAG, "Bus off, initiating recovery");
-                    twai_initiate_recovery();
-                    vTaskDelay(pdMS_TO_TICKS(5000));  // Wait for recovery
-                } else if (status.state == TWAI_STATE_STOPPED) {
-                    ESP_LOGI(TAG, "TWAI stopped, restarting");
-                    twai_start();
-                    vTaskDelay(pdMS_TO_TICKS(1000));
-                } else {
-                    // Try to recover from error state
-                    twai_stop();
-                    vTaskDelay(pdMS_TO_TICKS(100));
-                    twai_start();
-                    ESP_LOGI(TAG, "TWAI restarted after error");
-                }
-            }
-        } while (retries < MAX_RETRIES);
-
-        if (retries == MAX_RETRIES) {
-            ESP_LOGE(TAG, "Failed to send message %d after %d retries", i + 1, MAX_RETRIES);
-        }
-
-        vTaskDelay(pdMS_TO_TICKS(EXAMPLE_DELAY_BETWEEN_MSGS_MS));
-    }
-}
-
-void twai_receive_task(void *pvParameters) {
-    twai_message_t rx_message;
-    message_with_status_t message_with_status;
+// Built-in diagnostic sequences for the steering ECU (see seq_script.h).
+// Requests go over ISO-TP on 0x742/0x762; flow control for multi-frame
+// responses is generated by the transport. A script stored in NVS under the
+// same name replaces the built-in one.
+static const char angle_config_script[] =
+    "request 14 FF 00\n"
+    "request 31 01 00\n"
+    "request 31 01 01\n";
+
+// Status lives in the positive response to ReadDataByLocalIdentifier 0x01
+// (61 01 ...). Byte 20 is the 0x00 that follows the PCI of consecutive
+// frame 3, byte 22 the status byte: low nibble 0xC means Status 4.
+static const char status_check_script[] =
+    "request 10 C0\n"
+    "request 21 80\n"
+    "request 21 03\n"
+    "request 21 04\n"
+    "request 21 01\n"
+    "if resp[0] != 61 goto done\n"
+    "if resp[1] != 01 goto done\n"
+    "if resp[20] != 00 goto done\n"
+    "if resp[22] & 0F == 0C goto status4\n"
+    "status 3\n"
+    "end\n"
+    "status4: status 4\n"
+    "done: end\n";
+
+static isotp_link_t diag_link;
+
+LOW_LATENCY_IRAM void twai_receive_task(void *pvParameters) {
+    can_frame_t rx_message;
+    bool first_frame = true;
     while (1) {
-        esp_err_t result = twai_receive(&rx_message, pdMS_TO_TICKS(10000));
+        esp_err_t result = can_backend_receive(&rx_message, CAN_BACKEND_WAIT_FOREVER);
         if (result == ESP_OK) {
-            if (rx_message.identifier == 0x762 && rx_message.data[0] == 0x23 && rx_message.data[1] == 0x00) {
-                ESP_LOGI(TAG, "Received 0x762 frame: %02X %02X %02X %02X %02X %02X %02X %02X",
-                         rx_message.data[0], rx_message.data[1], rx_message.data[2], rx_message.data[3],
-                         rx_message.data[4], rx_message.data[5], rx_message.data[6], rx_message.data[7]);
-    
-                if ((rx_message.data[3] & 0x0F) == 0x0C) {
-                    current_status = 4;
-                    message_with_status.status = "Status 4";
-                    ESP_LOGI(TAG, "Status 4 detected (0x%02X)", rx_message.data[3]);
-                } else {
-                    current_status = 3;
-                    message_with_status.status = "Status 3";
-                    ESP_LOGI(TAG, "Status 3 detected (0x%02X)", rx_message.data[3]);
-                }
-    
-                message_with_status.message = rx_message;
-    
-                if (stored_message_count < MAX_STORED_MESSAGES) {
-                    stored_messages[stored_message_count++] = message_with_status;
-                } else {
-                    for (int i = 0; i < MAX_STORED_MESSAGES - 1; i++) {
-                        stored_messages[i] = stored_messages[i + 1];
-                    }
-                    stored_messages[MAX_STORED_MESSAGES - 1] = message_with_status;
-                }
+            int64_t now_us = esp_timer_get_time();
+            if (first_frame) {
+                first_frame = false;
+                boot_mark(BOOT_FIRST_FRAME);
             }
-        } else if (result != ESP_ERR_TIMEOUT) {
+            rx_process_frame(&rx_message, now_us);
+        } else {
+            // Bus errors and recovery are bus_recovery's business; a failing
+            // receive only needs a short back-off so the loop cannot spin.
             ESP_LOGE(TAG, "Failed to receive message, error: %s", esp_err_to_name(result));
-            
-            twai_status_info_t status;
-            twai_get_status_info(&status);
-            ESP_LOGI(TAG, "TWAI status: state=%lu, msgs_to_tx=%lu, msgs_to_rx=%lu, tx_error_counter=%lu, rx_error_counter=%lu",
-                     (unsigned long)status.state, (unsigned long)status.msgs_to_tx, (unsigned long)status.msgs_to_rx,
-                     (unsigned long)status.tx_error_counter, (unsigned long)status.rx_error_counter);
-
-            if (status.state == TWAI_STATE_BUS_OFF) {
-                ESP_LOGI(TAG, "Bus off, initiating recovery");
-                twai_initiate_recovery();
-                vTaskDelay(pdMS_TO_TICKS(5000));  // Wait for recovery
-            } else if (status.state == TWAI_STATE_STOPPED) {
-                ESP_LOGI(TAG, "TWAI stopped, restarting");
-                twai_start();
-                vTaskDelay(pdMS_TO_TICKS(1000));
-            }
+            metrics_inc(METRIC_RX_ERRORS);
+            vTaskDelay(pdMS_TO_TICKS(RX_ERROR_BACKOFF_MS));
         }
     }
 }
 
+#if !CONFIG_IDF_TARGET_LINUX
 void wifi_init_softap() {
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -183,299 +178,208 @@ void wifi_init_softap() {
 
     ESP_LOGI(TAG, "WiFi AP started. SSID:%s (Open Network)", WIFI_SSID);
 }
-
-static void countdown_timer_callback(void* arg) {
-    countdown_value--;
-    ESP_LOGI(TAG, "Countdown: %d", countdown_value);
-    if (countdown_value <= 0) {
-        esp_timer_stop(countdown_timer);
-        countdown_active = false;
-        send_twai_messages(angle_config_messages, sizeof(angle_config_messages) / sizeof(angle_config_messages[0]));
-    }
-}
-
-esp_err_t get_handler(httpd_req_t *req) {
-    char *response = malloc(8192);
-    if (response == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for response");
-        return ESP_FAIL;
-    }
-
-    char *p = response;
-    
-    // Check if it's an AJAX request
-    char *header = NULL;
-    size_t header_len = httpd_req_get_hdr_value_len(req, "X-Requested-With");
-    if (header_len > 0) {
-        header = malloc(header_len + 1);
-        if (httpd_req_get_hdr_value_str(req, "X-Requested-With", header, header_len + 1) == ESP_OK) {
-            if (strcmp(header, "XMLHttpRequest") == 0) {
-                // It's an AJAX request, only send the message list
-                p += sprintf(p, "<ul id='messageList'>");
-                for (int i = 0; i < stored_message_count; i++) {
-                    p += sprintf(p, "<li>ID: 0x762, Data: ");
-                    for (int j = 0; j < stored_messages[i].message.data_length_code; j++) {
-                        p += sprintf(p, "%02X ", stored_messages[i].message.data[j]);
-                    }
-                    p += sprintf(p, ", Status: %s</li>", stored_messages[i].status);
-                }
-                p += sprintf(p, "</ul>");
-                free(header);
-                httpd_resp_send(req, response, strlen(response));
-                free(response);
-                return ESP_OK;
-            }
+#endif
+
+// GET /messages[?since=<seq>]: frames received since the given sequence
+// number (at most MAX_DISPLAYED_MESSAGES, newest kept), or the latest ones.
+esp_err_t messages_handler(httpd_req_t *req) {
+    uint32_t head = rx_ring_head(&rx_ring);
+    uint32_t cursor = head - MAX_DISPLAYED_MESSAGES;
+    char query[32], value[12];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        uint32_t since = (uint32_t)strtoul(value, NULL, 10);
+        if (head - since < MAX_DISPLAYED_MESSAGES) {
+            cursor = since;
         }
-        free(header);
     }
 
-    // If it's not an AJAX request, send the full HTML page
-    p += sprintf(p, "<!DOCTYPE html>");
-    p += sprintf(p, "<html lang='es'><head><meta charset='UTF-8'><style>");
-    p += sprintf(p, "body { font-family: Arial, sans-serif; margin: 0; padding: 20px; }");
-    p += sprintf(p, ".button { background-color: #E4007B; border: none; color: white; padding: 15px 32px; text-align: center; text-decoration: none; display: inline-block; font-size: 16px; margin: 4px 2px; cursor: pointer; }");
-    p += sprintf(p, ".status { margin-left: 20px; display: inline-block; }");
-    p += sprintf(p, "#countdownBtn { display: block; margin: 20px 0; }");
-    p += sprintf(p, "#instructions { margin-top: 10px; }");
-    p += sprintf(p, ".status-box { background-color: #f0f0f0; padding: 10px; border-radius: 5px; display: inline-block; margin-left: 20px; }");
-    p += sprintf(p, ".calibration-complete { background-color: #4CAF50; padding: 10px; border-radius: 5px; display: inline-block; margin-left: 20px; color: white; }");
-    p += sprintf(p, ".status-box-3 { background-color: #f0f0f0; color: black; }");
-    p += sprintf(p, ".status-box-4 { background-color: #4CAF50; color: white; }");
-    p += sprintf(p, "</style></head><body>");
-    p += sprintf(p, "<h1>ESP32-C3 CAN Control Panel</h1>");
-    p += sprintf(p, "<div>");
-    p += sprintf(p, "<button class='button' onclick='sendStatusCheck()'>Comprobar configuración de ángulo de volante</button>");
-    p += sprintf(p, "<span id='statusBox' class='status-box' style='display: none;'></span>");
-    p  += sprintf(p, "</div>");
-    p += sprintf(p, "<br><br>");
-    p += sprintf(p, "<div style=\"display: flex; align-items: center;\">");
-    p += sprintf(p, "<button id='countdownBtn' class='button' onclick='startCountdown()'>Calibrar ángulo de volante</button>"); 
-    p += sprintf(p, "<span id='calibrationStatus' class='calibration-complete' style='display: none;'>Calibración completa</span>");
-    p += sprintf(p, "</div>");
-    p += sprintf(p, "<div id='instructions' style='display:none;'>");
-    p += sprintf(p, "1. Con el motor encendido, ponga el volante/ruedas en el centro.<br>");
-    p += sprintf(p, "2. Gire el volante a la izquierda hasta el tope.<br>");
-    p += sprintf(p, "3. Gire el volante a la derecha hasta el tope.<br>");
-    p += sprintf(p, "4. Vuelva a centrar el volante/ruedas y espere a que finalice la cuenta atrás.<br>");
-    p += sprintf(p, "5. Una vez finalizada este proceso, apague el coche y vuelva a encenderlo<br>");
-    p += sprintf(p, "</div>");
-    
-
-    for (int i = 0; i < stored_message_count; i++) {
-        p += sprintf(p, "<li>ID: 0x762, Data: ");
-        for (int j = 0; j < stored_messages[i].message.data_length_code; j++) {
-            p += sprintf(p, "%02X ", stored_messages[i].message.data[j]);
-        }
-        p += sprintf(p, ", Status: %s</li>", stored_messages[i].status);
-    }
+    can_record_t recent[MAX_DISPLAYED_MESSAGES];
+    size_t count = rx_ring_read(&rx_ring, &cursor, recent, MAX_DISPLAYED_MESSAGES);
 
-    p += sprintf(p, "</ul></div>");
-    p += sprintf(p, "<script>");
-    p += sprintf(p, "var countdown = 10;");
-    p += sprintf(p, "var countdownActive = false;");
-    p += sprintf(p, "var countdownInterval;");
-    p += sprintf(p, "function startCountdown() {");
-    p += sprintf(p, "  if (!countdownActive) {");
-    p += sprintf(p, "    countdownActive = true;");
-    p += sprintf(p, "    countdown = 10;");
-    p += sprintf(p, "    document.getElementById('instructions').style.display = 'block';");
-    p += sprintf(p, "    updateButton();");
-    p += sprintf(p, "    fetch('/start_countdown', { method: 'POST' })");
-    p += sprintf(p, "      .then(response => response.text())");
-    p += sprintf(p, "      .then(data => {");
-    p += sprintf(p, "        console.log(data);");
-    p += sprintf(p, "        countdownInterval = setInterval(function() {");
-    p += sprintf(p, "          countdown--;");
-    p += sprintf(p, "          updateButton();");
-    p += sprintf(p, "          if (countdown <= 0) {");
-    p += sprintf(p, "            clearInterval(countdownInterval);");
-    p += sprintf(p, "            countdownActive = false;");
-    p += sprintf(p, "            fetch('/calibrate', { method: 'POST' })");
-    p += sprintf(p, "              .then(response => response.text())");
-    p += sprintf(p, "              .then(data => {");
-    p += sprintf(p, "                console.log(data);");
-    p += sprintf(p, "                document.getElementById('calibrationStatus').innerHTML = 'Calibración completa';");
-    p += sprintf(p, "                document.getElementById('calibrationStatus').style.display = 'inline-block';");
-    p += sprintf(p, "              });");
-    p += sprintf(p, "          }");
-    p += sprintf(p, "        }, 1000);");
-    p += sprintf(p, "      });");
-    p += sprintf(p, "  }");
-    p += sprintf(p, "}");
-    p += sprintf(p, "function updateButton() {");
-    p += sprintf(p, "  var btn = document.getElementById('countdownBtn');");
-    p += sprintf(p, "  if (countdownActive) {");
-    p += sprintf(p, "    btn.innerHTML = 'Calibrando: ' + countdown + 's';"); 
-    p += sprintf(p, "    btn.disabled = true;");
-    p += sprintf(p, "  } else {");
-    p += sprintf(p, "    btn.innerHTML = 'Calibrar ángulo de volante';"); 
-    p += sprintf(p, "    btn.disabled = false;");
-    p += sprintf(p, "  }");
-    p += sprintf(p, "}");
-    // Modifica la función JavaScript sendStatusCheck()
-    p += sprintf(p, "function sendStatusCheck() {");
-    p += sprintf(p, "  var btn = document.querySelector('button');");
-    p += sprintf(p, "  btn.innerHTML = 'Comprobando...';");
-    p += sprintf(p, "  btn.disabled = true;");
-    p += sprintf(p, "  fetch('/status_check', { method: 'POST' })");
-    p += sprintf(p, "    .then(response => response.json())");
-    p += sprintf(p, "    .then(data => {");
-    p += sprintf(p, "      console.log(data);");
-    p += sprintf(p, "      var statusBox = document.getElementById('statusBox');");
-    p += sprintf(p, "      statusBox.innerHTML = 'Status ' + data.status;");
-    p += sprintf(p, "      statusBox.className = 'status-box status-box-' + data.status;");
-    p += sprintf(p, "      statusBox.style.display = 'inline-block';");
-    p += sprintf(p, "    })");
-    p += sprintf(p, "    .finally(() => {");
-    p += sprintf(p, "      btn.innerHTML = 'Comprobar configuración de ángulo de volante';");
-    p += sprintf(p, "      btn.disabled = false;");
-    p += sprintf(p, "    });");
-    p += sprintf(p, "}");
-    p += sprintf(p, "function updateMessages() {");
-    p += sprintf(p, "  fetch('/', { headers: { 'X-Requested-With': 'XMLHttpRequest' } })");
-    p += sprintf(p, "    .then(response => response.text())");
-    p += sprintf(p, "    .then(html => {");
-    p += sprintf(p, "      document.getElementById('messageListContainer').innerHTML = html;");
-    p += sprintf(p, "    });");
-    p += sprintf(p, "}");
-    p += sprintf(p, "setInterval(updateMessages, 5000);");
-    p += sprintf(p, "</script>");
-    p += sprintf(p, "</body></html>");
-
-    httpd_resp_set_type(req, "text/html; charset=UTF-8");
-    httpd_resp_send(req, response, strlen(response));
-    free(response);
-    return ESP_OK;
+    char response[2048];
+    size_t len = frame_json_list(response, sizeof(response), recent, count, &cursor);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, response, len);
 }
 
-esp_err_t start_countdown_handler(httpd_req_t *req) {
-    if (countdown_active) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Countdown already active");
-        return ESP_FAIL;
-    }
-    
-    countdown_value = 10;
-    countdown_active = true;
-    esp_err_t err = esp_timer_start_periodic(countdown_timer, 1000000); // 1 second interval
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start timer: %s", esp_err_to_name(err));
-        countdown_active = false;
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start timer");
-        return ESP_FAIL;
-    }
-    
-    httpd_resp_sendstr(req, "Countdown started");
-    return ESP_OK;
+// POST /status_check: queues the status check and returns the job (see
+// diag_jobs.h); its "status" holds the result once done.
+esp_err_t status_check_handler(httpd_req_t *req) {
+    return diag_jobs_submit_and_respond(req, "status_check");
 }
 
-esp_err_t calibrate_handler(httpd_req_t *req) {
-    httpd_resp_sendstr(req, "Calibration complete");
-    return ESP_OK;
+// POST /sequence/run?name=<n>: same as POST /jobs?sequence=<n>.
+esp_err_t sequence_run_handler(httpd_req_t *req) {
+    char query[48], name[SEQ_NAME_MAX];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "name", name, sizeof(name)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing name");
+        return ESP_FAIL;
+    }
+    return diag_jobs_submit_and_respond(req, name);
 }
 
-esp_err_t status_check_handler(httpd_req_t *req) {
-    // Reset the current status before sending messages
-    current_status = 0;
-
-    // Send the status check messages
-    send_twai_messages(status_check_messages, sizeof(status_check_messages) / sizeof(status_check_messages[0]));
-    
-    // Wait for a longer period to allow for message processing and response
-    vTaskDelay(pdMS_TO_TICKS(1000));  // Increased from 500 to 1000 ms
-    
-    // If no status was received, set it to 3 as a default
-    if (current_status != 3 && current_status != 4) {
-        current_status = 3;
-    }
-    
-    // Prepare and send the response
-    char response[32];
-    snprintf(response, sizeof(response), "{\"status\": %d}", current_status);
+esp_err_t can_stats_handler(httpd_req_t *req) {
+    char response[200];
+    snprintf(response, sizeof(response),
+             "{\"received\": %" PRIu32 ", \"accepted\": %" PRIu32 ", \"hw_exact\": %s, \"hw_ids\": %" PRIu32
+             ", \"bus_state\": \"%s\"}",
+             metrics_get(METRIC_RX_FRAMES), metrics_get(METRIC_RX_ACCEPTED), rx_hw_filter.exact ? "true" : "false",
+             rx_hw_filter.ids_accepted, bus_recovery_state_name(bus_recovery_state()));
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, response, strlen(response));
-
-    // Log the status for debugging
-    ESP_LOGI(TAG, "Status check completed. Current status: %d", current_status);
-
     return ESP_OK;
 }
 
 httpd_handle_t start_webserver() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.stack_size = 8192;
+    config.max_uri_handlers = 28;
+    config.lru_purge_enable = true;
     httpd_handle_t server = NULL;
 
     if (httpd_start(&server, &config) == ESP_OK) {
-        httpd_uri_t uri_get = {
-            .uri       = "/",
+        ESP_ERROR_CHECK(web_static_register(server));
+        ESP_ERROR_CHECK(ws_push_start(server, &rx_ring, WS_PUSH_TASK_PRIO));
+        ESP_ERROR_CHECK(capture_register(server));
+        ESP_ERROR_CHECK(metrics_register(server));
+        ESP_ERROR_CHECK(seq_register(server));
+        ESP_ERROR_CHECK(can_dispatch_register(server));
+        ESP_ERROR_CHECK(diag_jobs_register(server));
+        ESP_ERROR_CHECK(low_latency_register(server));
+        ESP_ERROR_CHECK(calibration_register(server));
+        ESP_ERROR_CHECK(boot_register(server));
+
+        httpd_uri_t uri_messages = {
+            .uri       = "/messages",
             .method    = HTTP_GET,
-            .handler   = get_handler,
+            .handler   = messages_handler,
             .user_ctx  = NULL
         };
-        httpd_register_uri_handler(server, &uri_get);
+        httpd_register_uri_handler(server, &uri_messages);
 
-        httpd_uri_t uri_start_countdown = {
-            .uri       = "/start_countdown",
+        httpd_uri_t uri_status_check = {
+            .uri       = "/status_check",
             .method    = HTTP_POST,
-            .handler   = start_countdown_handler,
+            .handler   = status_check_handler,
             .user_ctx  = NULL
         };
-        
-        httpd_register_uri_handler(server, &uri_start_countdown);
+        httpd_register_uri_handler(server, &uri_status_check);
 
-        httpd_uri_t uri_calibrate = {
-            .uri       = "/calibrate",
-            .method    = HTTP_POST,
-            .handler   = calibrate_handler,
+        httpd_uri_t uri_can_stats = {
+            .uri       = "/can_stats",
+            .method    = HTTP_GET,
+            .handler   = can_stats_handler,
             .user_ctx  = NULL
         };
-        httpd_register_uri_handler(server, &uri_calibrate);
+        httpd_register_uri_handler(server, &uri_can_stats);
 
-        httpd_uri_t uri_status_check = {
-            .uri       = "/status_check",
+        httpd_uri_t uri_sequence_run = {
+            .uri       = "/sequence/run",
             .method    = HTTP_POST,
-            .handler   = status_check_handler,
+            .handler   = sequence_run_handler,
             .user_ctx  = NULL
         };
-        httpd_register_uri_handler(server, &uri_status_check);
+        httpd_register_uri_handler(server, &uri_sequence_run);
     }
     return server;
 }
 
-void app_main() {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-
+// Wi-Fi and the web server take a few hundred milliseconds to come up;
+// they do it here while app_main initialises the diagnostic services.
+static void net_init_task(void *pvParameters) {
+#if !CONFIG_IDF_TARGET_LINUX
     wifi_init_softap();
+    boot_mark(BOOT_WIFI);
+#endif
 
     httpd_handle_t server = start_webserver();
     if (server == NULL) {
         ESP_LOGE(TAG, "Failed to start webserver");
     } else {
         ESP_LOGI(TAG, "Webserver started successfully");
+        boot_mark(BOOT_HTTPD);
     }
+    vTaskDelete(NULL);
+}
 
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(TX_GPIO_NUM, RX_GPIO_NUM, TWAI_MODE_NORMAL);
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
-
-    ESP_ERROR_CHECK(twai_driver_install(&g_config, &t_config, &f_config));
-    ESP_ERROR_CHECK(twai_start());
+// The CAN path comes up first: the ignition powers the device together
+// with the car, and the first frames should not wait for Wi-Fi. Everything
+// a frame touches on its way through the RX task is initialised before
+// the driver starts.
+void app_main() {
+    ESP_ERROR_CHECK(boot_init());
+    boot_mark(BOOT_APP_MAIN);
+
+    rx_ring_init(&rx_ring, rx_ring_storage, RX_RING_CAPACITY);
+    ESP_ERROR_CHECK(ecu_decode_init());
+    ESP_ERROR_CHECK(rx_path_init(&rx_ring, &diag_link));
+    ESP_ERROR_CHECK(resp_match_init());
+
+    isotp_config_t diag_link_config = {
+        .tx_id = DIAG_TX_ID,
+        .rx_id = DIAG_RX_ID,
+        .block_size = 16,
+        .st_min = 0,
+        .padding = 0x00,
+        .timeout_ms = DIAG_FRAME_TIMEOUT_MS,
+        .transmit = twai_tx_send,
+    };
+    ESP_ERROR_CHECK(isotp_init(&diag_link, &diag_link_config));
+    ESP_ERROR_CHECK(low_latency_init());
+
+    size_t rx_rule_count;
+    const can_rx_rule_t *rx_rules = can_dispatch_rules(&rx_rule_count);
+    can_backend_config_t can_config = {
+        .tx_gpio = TX_GPIO_NUM,
+        .rx_gpio = RX_GPIO_NUM,
+        .ifname = CAN_IFNAME,
+        .rx_queue_len = TWAI_RX_QUEUE_LEN,
+        .rules = CAPTURE_ACCEPT_ALL ? NULL : rx_rules,
+        .rule_count = rx_rule_count,
+    };
+    ESP_ERROR_CHECK(can_backend_install(&can_config, &rx_hw_filter));
+    ESP_LOGI(TAG, "RX filter: %s mode, code=0x%08" PRIx32 " mask=0x%08" PRIx32 ", %" PRIu32 " IDs, %s",
+             rx_hw_filter.single_filter ? "single" : "dual", rx_hw_filter.acceptance_code,
+             rx_hw_filter.acceptance_mask, rx_hw_filter.ids_accepted,
+             rx_hw_filter.exact ? "exact" : "software check enabled");
+    ESP_ERROR_CHECK(can_backend_start());
+    ESP_ERROR_CHECK(bus_recovery_start(BUS_RECOVERY_TASK_PRIO));
+    ESP_ERROR_CHECK(metrics_start(CAN_BITRATE));
+    ESP_ERROR_CHECK(twai_tx_start(TWAI_TX_TASK_PRIO));
+    xTaskCreate(twai_receive_task, "TWAI_receive_task", 4096, NULL, TWAI_RX_TASK_PRIO, NULL);
+    // The job worker only waits until a job is submitted, but must exist
+    // for low_latency_start() like every task in latency_tasks.
+    ESP_ERROR_CHECK(diag_jobs_start(DIAG_TASK_PRIO));
+    ESP_ERROR_CHECK(low_latency_start(latency_tasks, sizeof(latency_tasks) / sizeof(latency_tasks[0])));
+    ESP_LOGI(TAG, "CAN backend installed and started");
+    boot_mark(BOOT_CAN_LISTENING);
+
+    // NVS holds the Wi-Fi calibration data and the stored sequences
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    boot_mark(BOOT_NVS);
 
-    ESP_LOGI(TAG, "TWAI driver installed and started");
+    if (xTaskCreate(net_init_task, "net_init", 4096, NULL, NET_INIT_TASK_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create net_init task");
+    }
 
-    xTaskCreate(twai_receive_task, "TWAI_receive_task", 4096, NULL, TWAI_RX_TASK_PRIO, NULL);
+    ESP_ERROR_CHECK(seq_engine_init(&diag_link));
+    ESP_ERROR_CHECK(seq_define("angle_config", angle_config_script));
+    ESP_ERROR_CHECK(seq_define("status_check", status_check_script));
+    ESP_ERROR_CHECK(calibration_init());
+    boot_mark(BOOT_DIAG);
 
-    if (!timer_created) {
-        esp_timer_create_args_t timer_args = {
-            .callback = &countdown_timer_callback,
-            .name = "countdown_timer"
-        };
-        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &countdown_timer));
-        timer_created = true;
+    // Scans the whole capture partition, so it goes last
+    if (capture_init(CAPTURE_TASK_PRIO) != ESP_OK) {
+        ESP_LOGW(TAG, "Running without capture log");
     }
-}
\ No newline at end of file
+    boot_mark(BOOT_CAPTURE);
+}
@@ -0,0 +1,212 @@
+#include "metrics.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#endif
+#include "can_backend.h"
+
+#define METRICS_SAMPLE_MS       100
+#define METRICS_LOAD_WINDOW     (1000 / METRICS_SAMPLE_MS)
+#define METRICS_MAX_SEQS        8
+#define METRICS_BUF_SIZE        1024
+
+static const char *TAG = "METRICS";
+
+_Atomic uint32_t metrics_counters[METRIC_COUNTER_COUNT];
+_Atomic uint32_t metrics_gauges[METRIC_GAUGE_COUNT];
+metrics_hist_t metrics_hists[METRIC_HIST_COUNT];
+
+static metrics_seq_t *seqs[METRICS_MAX_SEQS];
+static _Atomic int seq_count;
+
+static esp_timer_handle_t sample_timer;
+static uint32_t bus_bitrate;
+
+void metrics_register_seq(metrics_seq_t *seq) {
+    int i = atomic_fetch_add(&seq_count, 1);
+    if (i < METRICS_MAX_SEQS) {
+        seqs[i] = seq;
+    } else {
+        atomic_store(&seq_count, METRICS_MAX_SEQS);
+        ESP_LOGW(TAG, "No room for sequence %s", seq->name);
+    }
+}
+
+static void sample_callback(void *arg) {
+    static uint32_t window_bits, window_ticks;
+
+    can_bus_status_t status;
+    if (can_backend_get_status(&status) == ESP_OK) {
+        metrics_max(METRIC_RX_QUEUE_HWM, status.rx_pending);
+        metrics_set(METRIC_TX_ERROR_COUNTER, status.tx_error_counter);
+        metrics_set(METRIC_RX_ERROR_COUNTER, status.rx_error_counter);
+    }
+
+    if (++window_ticks == METRICS_LOAD_WINDOW) {
+        uint32_t bits = metrics_get(METRIC_ACCEPTED_BITS);
+        uint64_t permille = (uint64_t)(bits - window_bits) * 1000 / bus_bitrate;
+        metrics_set(METRIC_ACCEPTED_LOAD_PERMILLE, permille > 1000 ? 1000 : (uint32_t)permille);
+        window_bits = bits;
+        window_ticks = 0;
+    }
+}
+
+esp_err_t metrics_start(uint32_t bitrate) {
+    bus_bitrate = bitrate;
+    esp_timer_create_args_t args = {
+        .callback = &sample_callback,
+        .name = "metrics_sample"
+    };
+    esp_err_t err = esp_timer_create(&args, &sample_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(sample_timer, METRICS_SAMPLE_MS * 1000);
+    }
+    return err;
+}
+
+typedef struct {
+    httpd_req_t *req;
+    char buf[METRICS_BUF_SIZE];
+    size_t len;
+    esp_err_t err;
+} metrics_out_t;
+
+static void out_flush(metrics_out_t *out) {
+    if (out->err == ESP_OK && out->len > 0) {
+        out->err = httpd_resp_send_chunk(out->req, out->buf, out->len);
+    }
+    out->len = 0;
+}
+
+static void out_printf(metrics_out_t *out, const char *fmt, ...) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(out->buf + out->len, sizeof(out->buf) - out->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && (size_t)n < sizeof(out->buf) - out->len) {
+            out->len += n;
+            return;
+        }
+        out_flush(out);
+    }
+}
+
+static void out_value(metrics_out_t *out, const char *type, const char *name, uint32_t value) {
+    out_printf(out, "# TYPE %s %s\n%s %" PRIu32 "\n", name, type, name, value);
+}
+
+static void out_hist(metrics_out_t *out, const char *name, const metrics_hist_t *h) {
+    uint32_t cumulative = 0;
+    out_printf(out, "# TYPE %s histogram\n", name);
+    for (int b = 0; b < METRIC_HIST_BUCKETS; b++) {
+        cumulative += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+        if (b < METRIC_HIST_BUCKETS - 1) {
+            out_printf(out, "%s_bucket{le=\"%lu\"} %" PRIu32 "\n", name, 1UL << b, cumulative);
+        } else {
+            out_printf(out, "%s_bucket{le=\"+Inf\"} %" PRIu32 "\n", name, cumulative);
+        }
+    }
+    out_printf(out, "%s_sum %" PRIu64 "\n%s_count %" PRIu32 "\n", name, h->sum_us, name, cumulative);
+}
+
+static void out_tasks(metrics_out_t *out) {
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    UBaseType_t n = uxTaskGetNumberOfTasks() + 2;
+    TaskStatus_t *tasks = malloc(n * sizeof(TaskStatus_t));
+    if (tasks == NULL) {
+        return;
+    }
+    n = uxTaskGetSystemState(tasks, n, NULL);
+    out_printf(out, "# TYPE task_stack_free_min_bytes gauge\n");
+    for (UBaseType_t i = 0; i < n; i++) {
+        out_printf(out, "task_stack_free_min_bytes{task=\"%s\"} %lu\n", tasks[i].pcTaskName,
+                   (unsigned long)tasks[i].usStackHighWaterMark);
+    }
+    free(tasks);
+#endif
+}
+
+static esp_err_t metrics_handler(httpd_req_t *req) {
+    metrics_out_t *out = malloc(sizeof(*out));
+    if (out == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    out->req = req;
+    out->len = 0;
+    out->err = ESP_OK;
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    out_value(out, "counter", "can_rx_frames_total", metrics_get(METRIC_RX_FRAMES));
+    out_value(out, "counter", "can_rx_accepted_total", metrics_get(METRIC_RX_ACCEPTED));
+    out_value(out, "counter", "can_rx_stored_total", metrics_get(METRIC_RX_STORED));
+    out_value(out, "counter", "can_rx_errors_total", metrics_get(METRIC_RX_ERRORS));
+    out_value(out, "counter", "can_rx_overruns_total", metrics_get(METRIC_RX_OVERRUNS));
+    out_value(out, "counter", "can_tx_frames_total", metrics_get(METRIC_TX_FRAMES));
+    out_value(out, "counter", "can_tx_retries_total", metrics_get(METRIC_TX_RETRIES));
+    out_value(out, "counter", "can_tx_failures_total", metrics_get(METRIC_TX_FAILURES));
+    out_value(out, "counter", "can_bus_off_total", metrics_get(METRIC_BUS_OFF));
+    out_value(out, "counter", "can_recoveries_total", metrics_get(METRIC_RECOVERIES));
+
+    out_value(out, "gauge", "can_rx_queue_max", metrics_gauges[METRIC_RX_QUEUE_HWM]);
+    out_value(out, "gauge", "can_tx_queue_max", metrics_gauges[METRIC_TX_QUEUE_HWM]);
+    out_value(out, "gauge", "isotp_rx_queue_max", metrics_gauges[METRIC_ISOTP_QUEUE_HWM]);
+    out_value(out, "gauge", "can_tx_error_counter", metrics_gauges[METRIC_TX_ERROR_COUNTER]);
+    out_value(out, "gauge", "can_rx_error_counter", metrics_gauges[METRIC_RX_ERROR_COUNTER]);
+    out_printf(out, "# HELP can_accepted_load_permille Bus time taken by accepted and sent frames; "
+               "traffic dropped by the acceptance filter is not counted\n");
+    out_value(out, "gauge", "can_accepted_load_permille", metrics_gauges[METRIC_ACCEPTED_LOAD_PERMILLE]);
+    out_value(out, "gauge", "can_bus_state", metrics_gauges[METRIC_BUS_STATE]);
+    out_value(out, "gauge", "low_latency_mode", metrics_gauges[METRIC_LOW_LATENCY_MODE]);
+
+    out_hist(out, "can_rx_store_latency_us", &metrics_hists[METRIC_HIST_RX_STORE]);
+    out_hist(out, "diag_response_latency_us", &metrics_hists[METRIC_HIST_REQ_RESP]);
+    out_hist(out, "can_wake_latency_us", &metrics_hists[METRIC_HIST_WAKE_LATENCY]);
+    out_hist(out, "seq_send_late_us", &metrics_hists[METRIC_HIST_SEQ_SEND_LATE]);
+
+    static const char *const seq_fields[] = {"runs", "failures", "tx_frames", "tx_retries"};
+    for (int f = 0; f < 4; f++) {
+        out_printf(out, "# TYPE diag_sequence_%s_total counter\n", seq_fields[f]);
+        for (int i = 0; i < atomic_load(&seq_count); i++) {
+            _Atomic uint32_t *values[] = {&seqs[i]->runs, &seqs[i]->failures, &seqs[i]->tx_frames, &seqs[i]->tx_retries};
+            out_printf(out, "diag_sequence_%s_total{sequence=\"%s\"} %" PRIu32 "\n",
+                       seq_fields[f], seqs[i]->name, atomic_load(values[f]));
+        }
+    }
+
+    out_tasks(out);
+#if !CONFIG_IDF_TARGET_LINUX
+    out_value(out, "gauge", "heap_free_bytes", esp_get_free_heap_size());
+    out_value(out, "gauge", "heap_free_min_bytes", esp_get_minimum_free_heap_size());
+    out_value(out, "gauge", "heap_largest_block_bytes", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+#endif
+
+    out_flush(out);
+    esp_err_t err = out->err;
+    free(out);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+esp_err_t metrics_register(httpd_handle_t server) {
+    httpd_uri_t uri_metrics = {
+        .uri       = "/metrics",
+        .method    = HTTP_GET,
+        .handler   = metrics_handler,
+        .user_ctx  = NULL
+    };
+    return httpd_register_uri_handler(server, &uri_metrics);
+}
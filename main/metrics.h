@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Runtime metrics served as Prometheus text on GET /metrics. Updates are
+// relaxed atomics, cheap enough for the RX path; a 100 ms sampler polls
+// the backend for queue depth and error counters and turns the bit counter
+// into a load estimate. Only frames past the acceptance filter and the
+// device's own are counted, so it is the load of the accepted traffic, not
+// of the whole bus.
+
+typedef enum {
+    METRIC_RX_FRAMES,           // delivered by the backend
+    METRIC_RX_ACCEPTED,         // matched a dispatch handler
+    METRIC_RX_STORED,           // pushed to the RX ring
+    METRIC_RX_ERRORS,
+    METRIC_RX_OVERRUNS,         // RX queue full or controller FIFO overrun alerts
+    METRIC_TX_FRAMES,
+    METRIC_TX_RETRIES,
+    METRIC_TX_FAILURES,         // frames given up after MAX_RETRIES
+    METRIC_BUS_OFF,
+    METRIC_RECOVERIES,          // controller restarts after bus-off
+    METRIC_ACCEPTED_BITS,       // nominal bits of every frame accepted or sent
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+typedef enum {
+    METRIC_RX_QUEUE_HWM,        // driver RX queue, sampled
+    METRIC_TX_QUEUE_HWM,        // TX batch queue
+    METRIC_ISOTP_QUEUE_HWM,
+    METRIC_TX_ERROR_COUNTER,
+    METRIC_RX_ERROR_COUNTER,
+    METRIC_ACCEPTED_LOAD_PERMILLE, // of METRIC_ACCEPTED_BITS, over the last second
+    METRIC_BUS_STATE,           // bus_state_t of the recovery task
+    METRIC_LOW_LATENCY_MODE,    // 1 while low-latency mode is on
+    METRIC_GAUGE_COUNT
+} metric_gauge_t;
+
+// Latency histograms in microseconds, log2 buckets (le 1, 2, 4 ... 2^19
+// and +Inf). Each histogram has a single writer task.
+typedef enum {
+    METRIC_HIST_RX_STORE,       // backend receive to RX ring and consumers
+    METRIC_HIST_REQ_RESP,       // last request frame sent to first response frame
+    METRIC_HIST_WAKE_LATENCY,   // timer deadline to the latency probe task running
+    METRIC_HIST_SEQ_SEND_LATE,  // sequence delay deadline to its send reaching the driver
+    METRIC_HIST_COUNT
+} metric_hist_t;
+
+#define METRIC_HIST_BUCKETS 21
+
+typedef struct {
+    _Atomic uint32_t buckets[METRIC_HIST_BUCKETS];
+    uint64_t sum_us;
+} metrics_hist_t;
+
+// Per diagnostic sequence. Registered once and updated by diag_task.
+typedef struct {
+    const char *name;
+    _Atomic uint32_t runs;
+    _Atomic uint32_t failures;
+    _Atomic uint32_t tx_frames;
+    _Atomic uint32_t tx_retries;
+} metrics_seq_t;
+
+extern _Atomic uint32_t metrics_counters[METRIC_COUNTER_COUNT];
+extern _Atomic uint32_t metrics_gauges[METRIC_GAUGE_COUNT];
+extern metrics_hist_t metrics_hists[METRIC_HIST_COUNT];
+
+static inline void metrics_add(metric_counter_t id, uint32_t n) {
+    atomic_fetch_add_explicit(&metrics_counters[id], n, memory_order_relaxed);
+}
+
+static inline void metrics_inc(metric_counter_t id) {
+    metrics_add(id, 1);
+}
+
+static inline uint32_t metrics_get(metric_counter_t id) {
+    return atomic_load_explicit(&metrics_counters[id], memory_order_relaxed);
+}
+
+static inline void metrics_set(metric_gauge_t id, uint32_t value) {
+    atomic_store_explicit(&metrics_gauges[id], value, memory_order_relaxed);
+}
+
+// Raises a high-water mark gauge to value if it is higher.
+static inline void metrics_max(metric_gauge_t id, uint32_t value) {
+    uint32_t cur = atomic_load_explicit(&metrics_gauges[id], memory_order_relaxed);
+    while (value > cur &&
+           !atomic_compare_exchange_weak_explicit(&metrics_gauges[id], &cur, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static inline void metrics_observe(metric_hist_t id, int64_t us) {
+    uint32_t v = us <= 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    unsigned b = v <= 1 ? 0 : 32 - __builtin_clz(v - 1);
+    if (b >= METRIC_HIST_BUCKETS) {
+        b = METRIC_HIST_BUCKETS - 1;
+    }
+    atomic_fetch_add_explicit(&metrics_hists[id].buckets[b], 1, memory_order_relaxed);
+    metrics_hists[id].sum_us += v;
+}
+
+// Nominal length of a data frame on the wire, without stuff bits.
+static inline uint32_t metrics_frame_bits(uint8_t dlc, bool extd) {
+    return (extd ? 67 : 47) + 8u * dlc;
+}
+
+void metrics_register_seq(metrics_seq_t *seq);
+
+// Starts the sampler. bitrate is used for the load estimate.
+esp_err_t metrics_start(uint32_t bitrate);
+esp_err_t metrics_register(httpd_handle_t server);
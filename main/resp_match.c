@@ -0,0 +1,121 @@
+#include "resp_match.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "low_latency.h"
+
+struct resp_waiter {
+    uint32_t identifier;
+    uint8_t prefix[8];
+    uint8_t prefix_len;
+    bool in_use;
+    bool matched;
+    int64_t deadline_us;
+    can_record_t reply;
+};
+
+static resp_waiter_t waiters[RESP_MATCH_MAX_WAITERS];
+static volatile uint32_t pending_mask = 0; // registered and not yet matched
+static EventGroupHandle_t match_events;
+static portMUX_TYPE waiters_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t resp_match_init(void) {
+    match_events = xEventGroupCreate();
+    return match_events != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+resp_waiter_t *resp_match_register(uint32_t identifier, const uint8_t *prefix, uint8_t prefix_len,
+                                   uint32_t timeout_ms) {
+    if (prefix_len > sizeof(waiters[0].prefix)) {
+        return NULL;
+    }
+
+    resp_waiter_t *w = NULL;
+    portENTER_CRITICAL(&waiters_lock);
+    for (int i = 0; i < RESP_MATCH_MAX_WAITERS; i++) {
+        if (!waiters[i].in_use) {
+            w = &waiters[i];
+            w->identifier = identifier;
+            memcpy(w->prefix, prefix, prefix_len);
+            w->prefix_len = prefix_len;
+            w->in_use = true;
+            w->matched = false;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&waiters_lock);
+    if (w == NULL) {
+        return NULL;
+    }
+
+    // Clear a stale bit before the waiter becomes visible to
+    // resp_match_offer(): clearing it afterwards could erase a match made
+    // by the RX task in between.
+    uint32_t bit = 1u << (w - waiters);
+    xEventGroupClearBits(match_events, bit);
+    portENTER_CRITICAL(&waiters_lock);
+    w->deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    pending_mask |= bit;
+    portEXIT_CRITICAL(&waiters_lock);
+    return w;
+}
+
+static void release(resp_waiter_t *w) {
+    w->in_use = false;
+    pending_mask &= ~(1u << (w - waiters));
+}
+
+esp_err_t resp_match_wait(resp_waiter_t *w, can_record_t *reply) {
+    EventBits_t bit = 1u << (w - waiters);
+    int64_t remaining_us = w->deadline_us - esp_timer_get_time();
+
+    if (remaining_us > 0) {
+        TickType_t ticks = pdMS_TO_TICKS((remaining_us + 999) / 1000);
+        xEventGroupWaitBits(match_events, bit, pdTRUE, pdTRUE, ticks > 0 ? ticks : 1);
+    }
+
+    esp_err_t err = ESP_ERR_TIMEOUT;
+    portENTER_CRITICAL(&waiters_lock);
+    if (w->matched) {
+        *reply = w->reply;
+        err = ESP_OK;
+    }
+    release(w);
+    portEXIT_CRITICAL(&waiters_lock);
+    return err;
+}
+
+void resp_match_cancel(resp_waiter_t *w) {
+    portENTER_CRITICAL(&waiters_lock);
+    release(w);
+    portEXIT_CRITICAL(&waiters_lock);
+}
+
+LOW_LATENCY_IRAM bool resp_match_offer(const can_record_t *rec) {
+    if (pending_mask == 0) {
+        return false;
+    }
+
+    EventBits_t completed = 0;
+    portENTER_CRITICAL(&waiters_lock);
+    for (int i = 0; i < RESP_MATCH_MAX_WAITERS; i++) {
+        resp_waiter_t *w = &waiters[i];
+        if (!(pending_mask & (1u << i)) || w->identifier != rec->identifier ||
+            rec->dlc < w->prefix_len || memcmp(rec->data, w->prefix, w->prefix_len) != 0 ||
+            rec->timestamp_us > w->deadline_us) {
+            continue;
+        }
+        w->reply = *rec;
+        w->matched = true;
+        pending_mask &= ~(1u << i);
+        completed |= 1u << i;
+    }
+    portEXIT_CRITICAL(&waiters_lock);
+
+    if (completed) {
+        xEventGroupSetBits(match_events, completed);
+    }
+    return completed != 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "rx_ring.h"
+
+// Request/response correlation between the task that transmits a request and
+// twai_receive_task. The requester registers the reply it expects before
+// sending; the RX task completes the waiter the moment a matching frame
+// arrives, so the requester wakes without polling or fixed sleeps.
+
+#define RESP_MATCH_MAX_WAITERS 4
+
+typedef struct resp_waiter resp_waiter_t;
+
+esp_err_t resp_match_init(void);
+
+// Registers an expected reply. Returns NULL if all waiter slots are busy.
+resp_waiter_t *resp_match_register(uint32_t identifier, const uint8_t *prefix, uint8_t prefix_len,
+                                   uint32_t timeout_ms);
+
+// Blocks until the reply arrives or the deadline passes and releases the
+// waiter. Returns ESP_OK with the matching frame in *reply, or ESP_ERR_TIMEOUT.
+esp_err_t resp_match_wait(resp_waiter_t *waiter, can_record_t *reply);
+
+// Releases a waiter that will not be waited on.
+void resp_match_cancel(resp_waiter_t *waiter);
+
+// Called by the RX task for every accepted frame. Returns true if the frame
+// completed at least one waiter.
+bool resp_match_offer(const can_record_t *rec);
@@ -0,0 +1,77 @@
+#include "rx_path.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "can_dispatch.h"
+#include "capture.h"
+#include "ecu_decode.h"
+#include "low_latency.h"
+#include "metrics.h"
+#include "resp_match.h"
+#include "ws_push.h"
+
+static const char *TAG = "RX_PATH";
+
+// Frames the application consumes, dispatched by identifier. The backend's
+// acceptance filter is derived from this table at startup; anything it
+// cannot express exactly is dropped by the dispatcher's ID lookup. Only the
+// diagnostic replies are stored; broadcasts just update the signal cache.
+static const LOW_LATENCY_DRAM can_handler_t rx_handlers[] = {
+    {.identifier = DIAG_RX_ID, .flags = CAN_DISPATCH_STORE},
+    {.identifier = DIAG_RX_ID, .prefix = {0x23, 0x00}, .prefix_len = 2, .decode = ecu_decode_status},
+    {.identifier = ECU_STEERING_ANGLE_ID, .decode = ecu_decode_steering_angle},
+    {.identifier = ECU_WHEEL_SPEED_ID, .decode = ecu_decode_wheel_speeds},
+    {.identifier = ECU_GATEWAY_DIAG_RX_ID, .decode = ecu_decode_uds_response,
+     .ctx = (void *)(intptr_t)ECU_SIGNAL_GATEWAY_RESPONSE},
+    {.identifier = ECU_ABS_DIAG_RX_ID, .decode = ecu_decode_uds_response,
+     .ctx = (void *)(intptr_t)ECU_SIGNAL_ABS_RESPONSE},
+};
+#define RX_HANDLER_COUNT (sizeof(rx_handlers) / sizeof(rx_handlers[0]))
+
+static rx_ring_t *rx_ring;
+static isotp_link_t *diag_link;
+
+esp_err_t rx_path_init(rx_ring_t *ring, isotp_link_t *link) {
+    rx_ring = ring;
+    diag_link = link;
+    return can_dispatch_init(rx_handlers, RX_HANDLER_COUNT);
+}
+
+LOW_LATENCY_IRAM void rx_process_frame(const can_frame_t *frame, int64_t now_us) {
+    can_record_t record;
+    metrics_inc(METRIC_RX_FRAMES);
+    metrics_add(METRIC_ACCEPTED_BITS, metrics_frame_bits(frame->dlc, frame->flags & CAN_FRAME_EXTD));
+    capture_record(frame->identifier,
+                   ((frame->flags & CAN_FRAME_EXTD) ? CAPTURE_FLAG_EXTD : 0) |
+                   ((frame->flags & CAN_FRAME_RTR) ? CAPTURE_FLAG_RTR : 0),
+                   frame->dlc, frame->data, now_us);
+
+    int flags = -1;
+    if (frame->flags == 0) {
+        record.timestamp_us = now_us;
+        record.identifier = (uint16_t)frame->identifier;
+        record.dlc = frame->dlc;
+        record.status = 0;
+        memcpy(record.data, frame->data, sizeof(record.data));
+        flags = can_dispatch_frame(&record);
+    }
+    if (flags < 0) {
+        return;
+    }
+    metrics_inc(METRIC_RX_ACCEPTED);
+    ESP_LOGD(TAG, "Received 0x%03" PRIx32 " frame: %02X %02X %02X %02X %02X %02X %02X %02X",
+             frame->identifier, frame->data[0], frame->data[1], frame->data[2], frame->data[3],
+             frame->data[4], frame->data[5], frame->data[6], frame->data[7]);
+    // Script waits may target any dispatched ID, stored or not
+    resp_match_offer(&record);
+
+    if (flags & CAN_DISPATCH_STORE) {
+        rx_ring_push(rx_ring, &record);
+        metrics_inc(METRIC_RX_STORED);
+        isotp_on_frame(diag_link, &record);
+        ws_push_notify();
+        metrics_observe(METRIC_HIST_RX_STORE, esp_timer_get_time() - now_us);
+    }
+}
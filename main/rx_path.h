@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "can_backend.h"
+#include "isotp.h"
+#include "rx_ring.h"
+
+// What the RX task does with each received frame, kept apart from the task
+// loop so the host benchmark (tools/bench) runs the same code. The frames
+// the application consumes are declared in rx_handlers (rx_path.c); the
+// backend's acceptance filter is derived from that table.
+
+#define DIAG_TX_ID 0x742    // steering ECU diagnostic requests
+#define DIAG_RX_ID 0x762    // and its responses
+
+// Builds the dispatch table from rx_handlers and binds the consumers of
+// stored frames. Call once, after ecu_decode_init() and before the RX task
+// starts.
+esp_err_t rx_path_init(rx_ring_t *ring, isotp_link_t *diag_link);
+
+// Counts and captures the frame, dispatches it and offers it to resp_match;
+// stored frames then go to the ring, ISO-TP and the WebSocket push. now_us
+// is the time the frame was received.
+void rx_process_frame(const can_frame_t *frame, int64_t now_us);
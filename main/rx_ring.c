@@ -0,0 +1,75 @@
+#include "rx_ring.h"
+
+#include <string.h>
+#include "low_latency.h"
+
+void rx_ring_init(rx_ring_t *ring, rx_ring_slot_t *storage, size_t capacity) {
+    ring->slots = storage;
+    ring->mask = (uint32_t)capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&storage[i].seq, RX_RING_SEQ_INVALID);
+    }
+    atomic_init(&ring->head, 0);
+}
+
+LOW_LATENCY_IRAM uint32_t rx_ring_push(rx_ring_t *ring, const can_record_t *rec) {
+    uint32_t seq = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (seq == RX_RING_SEQ_INVALID) {
+        seq = 0;
+    }
+    rx_ring_slot_t *slot = &ring->slots[seq & ring->mask];
+
+    atomic_store_explicit(&slot->seq, RX_RING_SEQ_INVALID, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->timestamp_us = rec->timestamp_us;
+    slot->identifier = rec->identifier;
+    slot->dlc = rec->dlc;
+    slot->status = rec->status;
+    memcpy(slot->data, rec->data, sizeof(slot->data));
+    atomic_store_explicit(&slot->seq, seq, memory_order_release);
+
+    atomic_store_explicit(&ring->head, seq + 1, memory_order_release);
+    return seq;
+}
+
+uint32_t rx_ring_head(const rx_ring_t *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+size_t rx_ring_read(const rx_ring_t *ring, uint32_t *cursor, can_record_t *out, size_t max) {
+    uint32_t head = rx_ring_head(ring);
+    uint32_t seq = *cursor;
+    size_t n = 0;
+
+    if (head - seq > ring->mask + 1) {
+        seq = head - (ring->mask + 1);
+    }
+
+    for (; seq != head && n < max; seq++) {
+        if (seq == RX_RING_SEQ_INVALID) {
+            continue;
+        }
+        rx_ring_slot_t *slot = &ring->slots[seq & ring->mask];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != seq) {
+            continue;
+        }
+
+        can_record_t *rec = &out[n];
+        rec->timestamp_us = slot->timestamp_us;
+        rec->identifier = slot->identifier;
+        rec->dlc = slot->dlc;
+        rec->status = slot->status;
+        memcpy(rec->data, slot->data, sizeof(rec->data));
+        atomic_thread_fence(memory_order_acquire);
+
+        // The producer lapped us while copying; drop the torn record.
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+            continue;
+        }
+        rec->seq = seq;
+        n++;
+    }
+
+    *cursor = seq;
+    return n;
+}
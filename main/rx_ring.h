@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-producer / multi-reader history of received frames.
+//
+// The producer (twai_receive_task) never blocks and does constant work per
+// frame. Readers copy records out without taking any lock; each slot carries
+// the sequence number it holds, so a reader that races with the producer
+// simply skips slots that were overwritten under it.
+
+#ifndef RX_RING_CAPACITY
+#define RX_RING_CAPACITY 2048   // must be a power of two
+#endif
+_Static_assert((RX_RING_CAPACITY & (RX_RING_CAPACITY - 1)) == 0, "RX_RING_CAPACITY must be a power of two");
+
+#define RX_RING_SEQ_INVALID 0xFFFFFFFFu
+
+typedef struct {
+    int64_t timestamp_us;
+    uint32_t seq;
+    uint16_t identifier;
+    uint8_t dlc;
+    uint8_t status;         // decoded status, 0 if not applicable
+    uint8_t data[8];
+} can_record_t;
+
+typedef struct {
+    int64_t timestamp_us;
+    _Atomic uint32_t seq;   // RX_RING_SEQ_INVALID while empty or being written
+    uint16_t identifier;
+    uint8_t dlc;
+    uint8_t status;
+    uint8_t data[8];
+} rx_ring_slot_t;
+
+typedef struct {
+    rx_ring_slot_t *slots;
+    uint32_t mask;
+    _Atomic uint32_t head;  // sequence number of the next record
+} rx_ring_t;
+
+void rx_ring_init(rx_ring_t *ring, rx_ring_slot_t *storage, size_t capacity);
+
+// Producer side. Stores the record (its seq field is ignored) and returns
+// the sequence number assigned to it.
+uint32_t rx_ring_push(rx_ring_t *ring, const can_record_t *rec);
+
+// Sequence number the next pushed record will get.
+uint32_t rx_ring_head(const rx_ring_t *ring);
+
+// Copies up to max records starting at *cursor, oldest first, and advances
+// *cursor past the last record examined. A cursor that has fallen more than
+// the capacity behind is moved forward to the oldest record still held.
+size_t rx_ring_read(const rx_ring_t *ring, uint32_t *cursor, can_record_t *out, size_t max);
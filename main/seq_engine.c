@@ -0,0 +1,623 @@
+#include "seq_engine.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "boot.h"
+#include "can_dispatch.h"
+#include "low_latency.h"
+#include "metrics.h"
+#include "resp_match.h"
+#include "twai_tx.h"
+
+#define SEQ_NVS_NAMESPACE       "seq"
+#define SEQ_PENDING_TIMEOUT_MS  5000    // P2*: after a "response pending" reply
+#define SEQ_LINK_TIMEOUT_MS     5000
+
+static const char *TAG = "SEQ";
+
+typedef struct {
+    char name[SEQ_NAME_MAX];
+    const char *builtin;        // NULL for sequences that only exist in NVS
+    char *source;               // active script
+    seq_program_t *prog;
+    seq_program_t *retired;     // replaced while running, freed after the run
+    bool from_nvs;
+    metrics_seq_t stats;
+} seq_slot_t;
+
+// Execution state of the running sequence
+typedef struct {
+    uint8_t frame[8];           // last frame matched by a wait step
+    uint8_t frame_len;
+    uint8_t resp[SEQ_MAX_RESPONSE];
+    size_t resp_len;
+    uint16_t loops[SEQ_MAX_OPS];
+    resp_waiter_t *armed;       // wait registered by the preceding send
+    int64_t mark_us;            // end of the previous step, delays count from here
+    int64_t send_due_us;        // deadline of the last delay, until a send uses it
+    int64_t exchange_us;        // start of the latest send or request
+    int64_t rtt_us;
+    uint8_t nrc;                // last negative response to a request
+} seq_ctx_t;
+
+static seq_slot_t slots[SEQ_MAX_SCRIPTS];
+static int slot_count;
+static SemaphoreHandle_t seq_lock;     // slots and the compiler
+static SemaphoreHandle_t run_lock;     // the executor and ctx
+static seq_program_t *running_prog;
+static seq_ctx_t ctx;
+static isotp_link_t *diag_link;
+
+static esp_timer_handle_t delay_timer;
+static TaskHandle_t delay_task;
+
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+static void IRAM_ATTR delay_timer_callback(void *arg) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(delay_task, &woken);
+    if (woken) {
+        esp_timer_isr_dispatch_need_yield();
+    }
+}
+#define DELAY_TIMER_DISPATCH ESP_TIMER_ISR
+#else
+static void delay_timer_callback(void *arg) {
+    xTaskNotifyGive(delay_task);
+}
+#define DELAY_TIMER_DISPATCH ESP_TIMER_TASK
+#endif
+
+// Sleeps on the timer until just before the deadline, then spins.
+static void wait_until(int64_t deadline_us) {
+    int64_t left = deadline_us - esp_timer_get_time();
+    if (left > SEQ_SPIN_US) {
+        delay_task = xTaskGetCurrentTaskHandle();
+        ulTaskNotifyTake(pdTRUE, 0);
+        esp_timer_start_once(delay_timer, left - SEQ_SPIN_US);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    while (esp_timer_get_time() < deadline_us) {
+    }
+}
+
+static esp_err_t step_send(const seq_op_t *op) {
+    if (op->flags & SEQ_F_ARM_WAIT) {
+        const seq_op_t *w = op + 1;
+        ctx.armed = resp_match_register(w->id, w->data, w->len, w->arg);
+        if (ctx.armed == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    tx_frame_t frame = {.identifier = op->id, .dlc = op->len};
+    memcpy(frame.data, op->data, sizeof(frame.data));
+    tx_result_t tx;
+    esp_err_t err = twai_tx_send(&frame, 1, &tx);
+    if (err != ESP_OK) {
+        if (ctx.armed != NULL) {
+            resp_match_cancel(ctx.armed);
+            ctx.armed = NULL;
+        }
+        return err;
+    }
+    if (ctx.send_due_us != 0) {
+        low_latency_observe_send(tx.start_us - ctx.send_due_us);
+        ctx.send_due_us = 0;
+    }
+    ctx.exchange_us = tx.start_us;
+    ctx.mark_us = tx.end_us;
+    return ESP_OK;
+}
+
+static esp_err_t step_wait(const seq_op_t *op) {
+    resp_waiter_t *w = ctx.armed != NULL ? ctx.armed : resp_match_register(op->id, op->data, op->len, op->arg);
+    ctx.armed = NULL;
+    ctx.send_due_us = 0;
+    if (w == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    can_record_t reply;
+    esp_err_t err = resp_match_wait(w, &reply);
+    if (err != ESP_OK) {
+        ctx.mark_us = esp_timer_get_time();
+        return err;
+    }
+    memcpy(ctx.frame, reply.data, sizeof(ctx.frame));
+    ctx.frame_len = reply.dlc;
+    ctx.rtt_us = reply.timestamp_us - ctx.exchange_us;
+    ctx.mark_us = reply.timestamp_us;
+    return ESP_OK;
+}
+
+static esp_err_t step_request(const seq_op_t *op) {
+    ctx.send_due_us = 0;
+    ctx.exchange_us = esp_timer_get_time();
+    esp_err_t err = isotp_request(diag_link, op->data, op->len, ctx.resp, sizeof(ctx.resp),
+                                  &ctx.resp_len, op->arg);
+    if (err == ESP_OK) {
+        metrics_observe(METRIC_HIST_REQ_RESP, diag_link->rx_start_us - diag_link->tx_done_us);
+    }
+    // 7F <sid> 78: the ECU needs more time, the real answer follows
+    while (err == ESP_OK && ctx.resp_len >= 3 && ctx.resp[0] == 0x7F && ctx.resp[2] == 0x78) {
+        err = isotp_receive(diag_link, ctx.resp, sizeof(ctx.resp), &ctx.resp_len, SEQ_PENDING_TIMEOUT_MS);
+    }
+    ctx.mark_us = esp_timer_get_time();
+    if (err != ESP_OK) {
+        ctx.resp_len = 0;
+        ESP_LOGE(TAG, "Request SID 0x%02X failed: %s", op->data[0], esp_err_to_name(err));
+        return err;
+    }
+    ctx.rtt_us = ctx.mark_us - ctx.exchange_us;
+    if (ctx.resp[0] == 0x7F) {
+        ctx.nrc = ctx.resp_len >= 3 ? ctx.resp[2] : 0xFF;
+        ESP_LOGW(TAG, "Request SID 0x%02X rejected, NRC 0x%02X", op->data[0], ctx.resp_len >= 3 ? ctx.resp[2] : 0);
+    } else {
+        ESP_LOGI(TAG, "Request SID 0x%02X: %u byte response in %" PRId64 " us", op->data[0],
+                 (unsigned)ctx.resp_len, ctx.rtt_us);
+    }
+    return ESP_OK;
+}
+
+static bool branch_taken(const seq_op_t *op) {
+    const uint8_t *src = (op->flags & SEQ_F_RESP) ? ctx.resp : ctx.frame;
+    size_t len = (op->flags & SEQ_F_RESP) ? ctx.resp_len : ctx.frame_len;
+    bool equal = op->index < len && (src[op->index] & op->mask) == op->value;
+    return (op->flags & SEQ_F_NOT_EQUAL) ? !equal : equal;
+}
+
+static esp_err_t execute(const seq_program_t *prog, seq_result_t *result) {
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.mark_us = esp_timer_get_time();
+    uint16_t pc = 0;
+
+    while (pc < prog->count) {
+        if (++result->steps > SEQ_MAX_STEPS) {
+            ESP_LOGE(TAG, "Step limit reached at op %u", pc);
+            return ESP_ERR_INVALID_STATE;
+        }
+        const seq_op_t *op = &prog->ops[pc];
+        esp_err_t err = ESP_OK;
+        uint16_t next = pc + 1;
+
+        switch (op->op) {
+        case SEQ_OP_SEND:
+            err = step_send(op);
+            break;
+        case SEQ_OP_WAIT:
+        case SEQ_OP_REQUEST:
+            err = op->op == SEQ_OP_WAIT ? step_wait(op) : step_request(op);
+            if (err == ESP_ERR_TIMEOUT && (op->flags & SEQ_F_ELSE)) {
+                err = ESP_OK;
+                next = op->target;
+            }
+            break;
+        case SEQ_OP_DELAY:
+            ctx.mark_us += op->arg;
+            ctx.send_due_us = ctx.mark_us;
+            wait_until(ctx.mark_us);
+            break;
+        case SEQ_OP_BRANCH:
+            if (branch_taken(op)) {
+                next = op->target;
+            }
+            break;
+        case SEQ_OP_GOTO:
+            next = op->target;
+            break;
+        case SEQ_OP_REPEAT:
+            if (ctx.loops[pc] < op->arg) {
+                ctx.loops[pc]++;
+                next = op->target;
+            } else {
+                ctx.loops[pc] = 0;
+            }
+            break;
+        case SEQ_OP_STATUS:
+            result->status = (int)op->arg;
+            result->rtt_us = ctx.rtt_us;
+            break;
+        case SEQ_OP_END:
+            return ESP_OK;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        pc = next;
+    }
+    return ESP_OK;
+}
+
+static seq_slot_t *find_slot(const char *name) {
+    for (int i = 0; i < slot_count; i++) {
+        if (strcmp(slots[i].name, name) == 0) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+static seq_slot_t *add_slot(const char *name) {
+    if (slot_count == SEQ_MAX_SCRIPTS || strlen(name) >= SEQ_NAME_MAX) {
+        return NULL;
+    }
+    seq_slot_t *slot = &slots[slot_count++];
+    strcpy(slot->name, name);
+    slot->stats.name = slot->name;
+    metrics_register_seq(&slot->stats);
+    return slot;
+}
+
+// Compiles src into a new program. Called with seq_lock held.
+static seq_program_t *compile(const char *src, seq_error_t *err) {
+    seq_program_t *prog = malloc(sizeof(*prog));
+    if (prog == NULL) {
+        err->line = 0;
+        err->message = "out of memory";
+        return NULL;
+    }
+    if (!seq_compile(src, prog, err)) {
+        free(prog);
+        return NULL;
+    }
+    // The acceptance filter and the dispatch table are fixed at start-up,
+    // so a wait for a frame they drop could only ever time out.
+    static char message[48];
+    for (uint16_t i = 0; i < prog->count; i++) {
+        const seq_op_t *op = &prog->ops[i];
+        if (op->op == SEQ_OP_WAIT && !can_dispatch_accepts(op->id, op->data, op->len)) {
+            snprintf(message, sizeof(message), "wait on %03" PRIX32 ": ID not in rx_handlers", op->id);
+            err->line = 0;
+            err->message = message;
+            free(prog);
+            return NULL;
+        }
+    }
+    return prog;
+}
+
+// Takes ownership of source and prog. Called with seq_lock held.
+static void install(seq_slot_t *slot, char *source, seq_program_t *prog, bool from_nvs) {
+    if (slot->source != slot->builtin) {
+        free(slot->source);
+    }
+    if (slot->prog != NULL && slot->prog == running_prog) {
+        slot->retired = slot->prog;
+    } else {
+        free(slot->prog);
+    }
+    slot->source = source;
+    slot->prog = prog;
+    slot->from_nvs = from_nvs;
+    ESP_LOGI(TAG, "Sequence %s: %u ops (%s)", slot->name, prog->count, from_nvs ? "NVS" : "built-in");
+}
+
+static char *nvs_load(nvs_handle_t nvs, const char *name) {
+    size_t len = 0;
+    if (nvs_get_str(nvs, name, NULL, &len) != ESP_OK || len > SEQ_MAX_SOURCE + 1) {
+        return NULL;
+    }
+    char *src = malloc(len);
+    if (src != NULL && nvs_get_str(nvs, name, src, &len) != ESP_OK) {
+        free(src);
+        src = NULL;
+    }
+    return src;
+}
+
+// Loads and compiles the NVS copy of a sequence if there is a valid one.
+// Called with seq_lock held.
+static bool load_from_nvs(const char *name, char **src, seq_program_t **prog) {
+    nvs_handle_t nvs;
+    if (nvs_open(SEQ_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    *src = nvs_load(nvs, name);
+    nvs_close(nvs);
+    if (*src == NULL) {
+        return false;
+    }
+    seq_error_t err;
+    *prog = compile(*src, &err);
+    if (*prog == NULL) {
+        ESP_LOGW(TAG, "Ignoring stored sequence %s, line %d: %s", name, err.line, err.message);
+        free(*src);
+        return false;
+    }
+    return true;
+}
+
+esp_err_t seq_engine_init(isotp_link_t *link) {
+    diag_link = link;
+    seq_lock = xSemaphoreCreateMutex();
+    run_lock = xSemaphoreCreateMutex();
+    if (seq_lock == NULL || run_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_timer_create_args_t args = {
+        .callback = &delay_timer_callback,
+        .dispatch_method = DELAY_TIMER_DISPATCH,
+        .name = "seq_delay"
+    };
+    esp_err_t err = esp_timer_create(&args, &delay_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Sequences that exist only in NVS, e.g. uploaded for another platform
+    nvs_iterator_t it = NULL;
+    esp_err_t res = nvs_entry_find(NVS_DEFAULT_PART_NAME, SEQ_NVS_NAMESPACE, NVS_TYPE_STR, &it);
+    while (res == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        char *src;
+        seq_program_t *prog;
+        if (find_slot(info.key) == NULL && load_from_nvs(info.key, &src, &prog)) {
+            seq_slot_t *slot = add_slot(info.key);
+            if (slot != NULL) {
+                install(slot, src, prog, true);
+            } else {
+                free(prog);
+                free(src);
+            }
+        }
+        res = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    return ESP_OK;
+}
+
+esp_err_t seq_define(const char *name, const char *builtin_src) {
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(seq_lock, portMAX_DELAY);
+    seq_slot_t *slot = find_slot(name);
+    if (slot == NULL) {
+        slot = add_slot(name);
+    }
+    if (slot == NULL) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        char *src;
+        seq_program_t *prog;
+        slot->builtin = builtin_src;
+        if (slot->prog != NULL) {
+            // already loaded from NVS by seq_engine_init()
+        } else if (load_from_nvs(name, &src, &prog)) {
+            install(slot, src, prog, true);
+        } else {
+            seq_error_t err;
+            prog = compile(builtin_src, &err);
+            if (prog == NULL) {
+                ESP_LOGE(TAG, "Built-in sequence %s, line %d: %s", name, err.line, err.message);
+                ret = ESP_ERR_INVALID_ARG;
+            } else {
+                install(slot, (char *)builtin_src, prog, false);
+            }
+        }
+    }
+    xSemaphoreGive(seq_lock);
+    return ret;
+}
+
+esp_err_t seq_run(const char *name, seq_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    xSemaphoreTake(run_lock, portMAX_DELAY);
+    xSemaphoreTake(seq_lock, portMAX_DELAY);
+    seq_slot_t *slot = find_slot(name);
+    seq_program_t *prog = slot != NULL ? slot->prog : NULL;
+    running_prog = prog;
+    xSemaphoreGive(seq_lock);
+    // seq_lock is not held while the sequence runs, so the HTTP handlers
+    // stay responsive; a script replaced meanwhile is retired, not freed.
+
+    if (prog == NULL) {
+        result->err = ESP_ERR_NOT_FOUND;
+    } else if (!isotp_lock(diag_link, SEQ_LINK_TIMEOUT_MS)) {
+        result->err = ESP_ERR_TIMEOUT;
+    } else {
+        // Sequences are the only TX client, so the deltas of the global
+        // counters belong to this run.
+        uint32_t tx_frames = metrics_get(METRIC_TX_FRAMES);
+        uint32_t tx_retries = metrics_get(METRIC_TX_RETRIES);
+        result->err = execute(prog, result);
+        result->nrc = ctx.nrc;
+        atomic_fetch_add(&slot->stats.runs, 1);
+        atomic_fetch_add(&slot->stats.failures, result->err != ESP_OK ? 1 : 0);
+        atomic_fetch_add(&slot->stats.tx_frames, metrics_get(METRIC_TX_FRAMES) - tx_frames);
+        atomic_fetch_add(&slot->stats.tx_retries, metrics_get(METRIC_TX_RETRIES) - tx_retries);
+        isotp_unlock(diag_link);
+    }
+
+    xSemaphoreTake(seq_lock, portMAX_DELAY);
+    running_prog = NULL;
+    if (slot != NULL) {
+        free(slot->retired);
+        slot->retired = NULL;
+    }
+    xSemaphoreGive(seq_lock);
+    xSemaphoreGive(run_lock);
+    return result->err;
+}
+
+bool seq_name_valid(const char *name) {
+    size_t len = 0;
+    for (; name[len] != '\0'; len++) {
+        char c = name[len];
+        if (len >= SEQ_NAME_MAX - 1 ||
+            !((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return len > 0;
+}
+
+static bool name_from_query(httpd_req_t *req, char *name) {
+    char query[48];
+    return httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+           httpd_query_key_value(query, "name", name, SEQ_NAME_MAX) == ESP_OK && name[0] != '\0';
+}
+
+static esp_err_t sequence_get_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_DIAG))) {
+        return ESP_OK;
+    }
+    char name[SEQ_NAME_MAX];
+    xSemaphoreTake(seq_lock, portMAX_DELAY);
+    if (!name_from_query(req, name)) {
+        char response[512];
+        size_t len = snprintf(response, sizeof(response), "[");
+        for (int i = 0; i < slot_count && len < sizeof(response); i++) {
+            len += snprintf(response + len, sizeof(response) - len, "%s{\"name\":\"%s\",\"source\":\"%s\",\"ops\":%u}",
+                            i ? "," : "", slots[i].name, slots[i].from_nvs ? "nvs" : "builtin",
+                            slots[i].prog != NULL ? slots[i].prog->count : 0);
+        }
+        xSemaphoreGive(seq_lock);
+        if (len >= sizeof(response) - 1) {
+            httpd_resp_send_500(req);
+            return ESP_FAIL;
+        }
+        response[len++] = ']';
+        httpd_resp_set_type(req, "application/json");
+        return httpd_resp_send(req, response, len);
+    }
+
+    seq_slot_t *slot = find_slot(name);
+    esp_err_t err;
+    if (slot == NULL || slot->source == NULL) {
+        err = httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown sequence");
+    } else {
+        httpd_resp_set_type(req, "text/plain");
+        err = httpd_resp_send(req, slot->source, HTTPD_RESP_USE_STRLEN);
+    }
+    xSemaphoreGive(seq_lock);
+    return err;
+}
+
+static esp_err_t sequence_put_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_DIAG))) {
+        return ESP_OK;
+    }
+    char name[SEQ_NAME_MAX];
+    if (!name_from_query(req, name)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing name");
+        return ESP_FAIL;
+    }
+    if (!seq_name_valid(name)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Name may only use A-Z, a-z, 0-9, _ and -");
+        return ESP_FAIL;
+    }
+    if (req->content_len == 0 || req->content_len > SEQ_MAX_SOURCE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Script empty or too long");
+        return ESP_FAIL;
+    }
+    char *src = malloc(req->content_len + 1);
+    if (src == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    size_t got = 0;
+    while (got < req->content_len) {
+        int n = httpd_req_recv(req, src + got, req->content_len - got);
+        if (n <= 0) {
+            free(src);
+            return ESP_FAIL;
+        }
+        got += n;
+    }
+    src[got] = '\0';
+
+    xSemaphoreTake(seq_lock, portMAX_DELAY);
+    seq_error_t cerr;
+    seq_program_t *prog = compile(src, &cerr);
+    seq_slot_t *slot = find_slot(name);
+    if (prog != NULL && slot == NULL) {
+        slot = add_slot(name);
+    }
+
+    char msg[80];
+    esp_err_t err = ESP_FAIL;
+    nvs_handle_t nvs;
+    if (prog == NULL) {
+        snprintf(msg, sizeof(msg), "line %d: %s", cerr.line, cerr.message);
+    } else if (slot == NULL) {
+        snprintf(msg, sizeof(msg), "no room for another sequence");
+    } else if (nvs_open(SEQ_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        snprintf(msg, sizeof(msg), "NVS unavailable");
+    } else {
+        err = nvs_set_str(nvs, name, src);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+        snprintf(msg, sizeof(msg), "NVS write failed: %s", esp_err_to_name(err));
+    }
+
+    if (err == ESP_OK) {
+        install(slot, src, prog, true);
+        snprintf(msg, sizeof(msg), "{\"name\":\"%s\",\"ops\":%u}", name, prog->count);
+    } else {
+        free(prog);
+        free(src);
+    }
+    xSemaphoreGive(seq_lock);
+
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, msg, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t sequence_delete_handler(httpd_req_t *req) {
+    if (!boot_gate(req, BOOT_BIT(BOOT_DIAG))) {
+        return ESP_OK;
+    }
+    char name[SEQ_NAME_MAX];
+    if (!name_from_query(req, name)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing name");
+        return ESP_FAIL;
+    }
+    nvs_handle_t nvs;
+    if (nvs_open(SEQ_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, name);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+
+    xSemaphoreTake(seq_lock, portMAX_DELAY);
+    seq_slot_t *slot = find_slot(name);
+    if (slot != NULL && slot->from_nvs && slot->builtin != NULL) {
+        seq_error_t cerr;
+        seq_program_t *prog = compile(slot->builtin, &cerr);
+        if (prog != NULL) {
+            install(slot, (char *)slot->builtin, prog, false);
+        }
+    }
+    // Sequences without a built-in keep running from RAM until reboot.
+    xSemaphoreGive(seq_lock);
+    return httpd_resp_sendstr(req, "Deleted");
+}
+
+esp_err_t seq_register(httpd_handle_t server) {
+    httpd_uri_t uris[] = {
+        {.uri = "/sequence", .method = HTTP_GET,    .handler = sequence_get_handler,    .user_ctx = NULL},
+        {.uri = "/sequence", .method = HTTP_PUT,    .handler = sequence_put_handler,    .user_ctx = NULL},
+        {.uri = "/sequence", .method = HTTP_DELETE, .handler = sequence_delete_handler, .user_ctx = NULL},
+    };
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        esp_err_t err = httpd_register_uri_handler(server, &uris[i]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
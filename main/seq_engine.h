@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "isotp.h"
+#include "seq_script.h"
+
+// Named diagnostic sequences (see seq_script.h for the script language).
+// Each name has a built-in script compiled into the firmware; a script
+// stored in NVS under the same name replaces it, so a vehicle platform is
+// configured without a new build. Scripts are compiled once, when defined
+// or uploaded, and executed from the flat op array.
+//
+//   GET    /sequence                list of sequences as JSON
+//   GET    /sequence?name=<n>       script source
+//   PUT    /sequence?name=<n>       validate, store in NVS and activate
+//   DELETE /sequence?name=<n>       drop the NVS copy, back to the built-in
+//
+// Delays are timed by a one-shot esp_timer that wakes the executor shortly
+// before the deadline; the last SEQ_SPIN_US are busy-waited, so steps land
+// within a few microseconds of their target instead of on a tick.
+
+#define SEQ_MAX_SCRIPTS 8
+#define SEQ_NAME_MAX    16      // NVS key limit, including the terminator
+#define SEQ_SPIN_US     100
+#define SEQ_MAX_STEPS   10000   // guards against scripts that never end
+
+typedef struct {
+    esp_err_t err;          // ESP_OK, or the error of the step that failed
+    int status;             // value of the last "status" step, 0 if none
+    int64_t rtt_us;         // exchange that preceded that "status" step
+    uint32_t steps;         // ops executed, updated while the sequence runs
+    uint8_t nrc;            // NRC of the last request answered negatively, 0 if none
+} seq_result_t;
+
+esp_err_t seq_engine_init(isotp_link_t *link);
+
+// True if name fits in SEQ_NAME_MAX and only uses A-Z, a-z, 0-9, '_' and
+// '-'. Names go into JSON and NVS keys unescaped, so uploads and job
+// submissions are checked against this.
+bool seq_name_valid(const char *name);
+
+// Makes a sequence available under name, using the NVS copy if there is a
+// valid one and builtin_src otherwise.
+esp_err_t seq_define(const char *name, const char *builtin_src);
+
+// Runs a sequence to completion in the calling task. Holds the diagnostic
+// link for the whole run; runs from different tasks are serialised.
+esp_err_t seq_run(const char *name, seq_result_t *result);
+
+esp_err_t seq_register(httpd_handle_t server);
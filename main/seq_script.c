@@ -0,0 +1,306 @@
+#include "seq_script.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TOKENS      16
+#define MAX_LABEL_LEN   24
+
+typedef struct {
+    char name[MAX_LABEL_LEN];
+    uint16_t op;
+} label_t;
+
+typedef struct {
+    seq_program_t *prog;
+    label_t labels[SEQ_MAX_LABELS];
+    int label_count;
+    // Unresolved jump of each op, indexed like prog->ops
+    char fixups[SEQ_MAX_OPS][MAX_LABEL_LEN];
+    int fixup_lines[SEQ_MAX_OPS];
+} compiler_t;
+
+static bool parse_uint(const char *tok, int base, uint32_t max, uint32_t *out) {
+    char *end;
+    if (tok == NULL || *tok == '\0') {
+        return false;
+    }
+    unsigned long v = strtoul(tok, &end, base);
+    if (*end != '\0' || v > max) {
+        return false;
+    }
+    *out = (uint32_t)v;
+    return true;
+}
+
+static bool parse_byte(const char *tok, uint8_t *out) {
+    uint32_t v;
+    if (!parse_uint(tok, 16, 0xFF, &v)) {
+        return false;
+    }
+    *out = (uint8_t)v;
+    return true;
+}
+
+static const char *set_label_ref(compiler_t *c, uint16_t op, const char *name, int line) {
+    if (name == NULL || strlen(name) >= MAX_LABEL_LEN) {
+        return "bad label";
+    }
+    strcpy(c->fixups[op], name);
+    c->fixup_lines[op] = line;
+    return NULL;
+}
+
+// Parses "<bytes...> [timeout <ms>] [else <label>]" starting at tok[i].
+static const char *parse_bytes_tail(compiler_t *c, seq_op_t *op, char **tok, int n, int i, int line) {
+    op->arg = SEQ_DEFAULT_TIMEOUT_MS;
+    for (; i < n && strcmp(tok[i], "timeout") != 0 && strcmp(tok[i], "else") != 0; i++) {
+        if (op->len == sizeof(op->data)) {
+            return "more than 8 data bytes";
+        }
+        if (!parse_byte(tok[i], &op->data[op->len++])) {
+            return "bad data byte";
+        }
+    }
+    if (i < n && strcmp(tok[i], "timeout") == 0) {
+        if (i + 1 >= n || !parse_uint(tok[i + 1], 10, SEQ_MAX_TIMEOUT_MS, &op->arg) || op->arg == 0) {
+            return "bad timeout";
+        }
+        i += 2;
+    }
+    if (i < n && strcmp(tok[i], "else") == 0) {
+        op->flags |= SEQ_F_ELSE;
+        const char *e = set_label_ref(c, c->prog->count, i + 1 < n ? tok[i + 1] : NULL, line);
+        if (e != NULL) {
+            return e;
+        }
+        i += 2;
+    }
+    return i == n ? NULL : "unexpected token";
+}
+
+// "frame[3]" / "resp[22]"
+static const char *parse_operand(const char *tok, seq_op_t *op) {
+    unsigned idx;
+    char close;
+    if (sscanf(tok, "frame[%u%c", &idx, &close) == 2 && close == ']' && idx < 8) {
+        op->index = (uint16_t)idx;
+        return NULL;
+    }
+    if (sscanf(tok, "resp[%u%c", &idx, &close) == 2 && close == ']' && idx < SEQ_MAX_RESPONSE) {
+        op->index = (uint16_t)idx;
+        op->flags |= SEQ_F_RESP;
+        return NULL;
+    }
+    return "expected frame[n] or resp[n]";
+}
+
+static const char *parse_branch(compiler_t *c, seq_op_t *op, char **tok, int n, int line) {
+    int i = 1;
+    if (n < 2) {
+        return "missing operand";
+    }
+    const char *e = parse_operand(tok[i++], op);
+    if (e != NULL) {
+        return e;
+    }
+    op->mask = 0xFF;
+    if (i + 1 < n && strcmp(tok[i], "&") == 0) {
+        if (!parse_byte(tok[i + 1], &op->mask)) {
+            return "bad mask";
+        }
+        i += 2;
+    }
+    if (i + 4 != n || strcmp(tok[i + 2], "goto") != 0) {
+        return "expected '==|!= <value> goto <label>'";
+    }
+    if (strcmp(tok[i], "!=") == 0) {
+        op->flags |= SEQ_F_NOT_EQUAL;
+    } else if (strcmp(tok[i], "==") != 0) {
+        return "expected == or !=";
+    }
+    if (!parse_byte(tok[i + 1], &op->value)) {
+        return "bad value";
+    }
+    return set_label_ref(c, c->prog->count, tok[i + 3], line);
+}
+
+static const char *parse_line(compiler_t *c, char **tok, int n, int line) {
+    seq_op_t op = {0};
+    const char *e = NULL;
+    uint32_t v;
+
+    if (c->prog->count >= SEQ_MAX_OPS - 1) {
+        return "too many steps";
+    }
+    c->fixups[c->prog->count][0] = '\0';
+
+    if (strcmp(tok[0], "send") == 0) {
+        op.op = SEQ_OP_SEND;
+        if (n < 2 || !parse_uint(tok[1], 16, 0x7FF, &op.id)) {
+            return "bad identifier";
+        }
+        if (n - 2 > 8) {
+            return "more than 8 data bytes";
+        }
+        for (int i = 2; i < n; i++) {
+            if (!parse_byte(tok[i], &op.data[op.len++])) {
+                return "bad data byte";
+            }
+        }
+    } else if (strcmp(tok[0], "wait") == 0) {
+        op.op = SEQ_OP_WAIT;
+        if (n < 2 || !parse_uint(tok[1], 16, 0x7FF, &op.id)) {
+            return "bad identifier";
+        }
+        e = parse_bytes_tail(c, &op, tok, n, 2, line);
+    } else if (strcmp(tok[0], "request") == 0) {
+        op.op = SEQ_OP_REQUEST;
+        e = parse_bytes_tail(c, &op, tok, n, 1, line);
+        if (e == NULL && op.len == 0) {
+            e = "empty request";
+        }
+    } else if (strcmp(tok[0], "delay") == 0) {
+        op.op = SEQ_OP_DELAY;
+        if (n != 2 || !parse_uint(tok[1], 10, SEQ_MAX_DELAY_US, &op.arg)) {
+            return "bad delay";
+        }
+    } else if (strcmp(tok[0], "if") == 0) {
+        op.op = SEQ_OP_BRANCH;
+        e = parse_branch(c, &op, tok, n, line);
+    } else if (strcmp(tok[0], "goto") == 0) {
+        op.op = SEQ_OP_GOTO;
+        e = n == 2 ? set_label_ref(c, c->prog->count, tok[1], line) : "expected goto <label>";
+    } else if (strcmp(tok[0], "repeat") == 0) {
+        op.op = SEQ_OP_REPEAT;
+        if (n != 3 || !parse_uint(tok[1], 10, 0xFFFF, &op.arg)) {
+            return "expected repeat <count> <label>";
+        }
+        e = set_label_ref(c, c->prog->count, tok[2], line);
+    } else if (strcmp(tok[0], "status") == 0) {
+        op.op = SEQ_OP_STATUS;
+        if (n != 2 || !parse_uint(tok[1], 10, 0xFFFF, &v)) {
+            return "bad status";
+        }
+        op.arg = v;
+    } else if (strcmp(tok[0], "end") == 0) {
+        op.op = SEQ_OP_END;
+        if (n != 1) {
+            return "unexpected token";
+        }
+    } else {
+        return "unknown step";
+    }
+
+    if (e == NULL) {
+        c->prog->ops[c->prog->count++] = op;
+    }
+    return e;
+}
+
+static const char *add_label(compiler_t *c, const char *name) {
+    if (c->label_count == SEQ_MAX_LABELS) {
+        return "too many labels";
+    }
+    if (*name == '\0' || strlen(name) >= MAX_LABEL_LEN) {
+        return "bad label";
+    }
+    for (int i = 0; i < c->label_count; i++) {
+        if (strcmp(c->labels[i].name, name) == 0) {
+            return "duplicate label";
+        }
+    }
+    strcpy(c->labels[c->label_count].name, name);
+    c->labels[c->label_count].op = c->prog->count;
+    c->label_count++;
+    return NULL;
+}
+
+bool seq_compile(const char *src, seq_program_t *prog, seq_error_t *err) {
+    static compiler_t c;    // too big for a task stack; callers hold the engine lock
+    char linebuf[128];
+    int line = 0;
+
+    memset(&c, 0, sizeof(c));
+    memset(prog, 0, sizeof(*prog));
+    c.prog = prog;
+    err->line = 0;
+    err->message = NULL;
+
+    if (strlen(src) > SEQ_MAX_SOURCE) {
+        err->message = "script too long";
+        return false;
+    }
+
+    while (*src != '\0') {
+        size_t len = strcspn(src, "\n");
+        line++;
+        if (len >= sizeof(linebuf)) {
+            err->line = line;
+            err->message = "line too long";
+            return false;
+        }
+        memcpy(linebuf, src, len);
+        linebuf[len] = '\0';
+        src += len + (src[len] == '\n');
+
+        char *hash = strchr(linebuf, '#');
+        if (hash != NULL) {
+            *hash = '\0';
+        }
+        char *tok[MAX_TOKENS];
+        char *save;
+        int n = 0;
+        for (char *t = strtok_r(linebuf, " \t\r", &save); t != NULL; t = strtok_r(NULL, " \t\r", &save)) {
+            if (n == MAX_TOKENS) {
+                err->line = line;
+                err->message = "too many tokens";
+                return false;
+            }
+            tok[n++] = t;
+        }
+
+        // Leading "label:" tokens
+        int first = 0;
+        while (first < n && tok[first][strlen(tok[first]) - 1] == ':') {
+            tok[first][strlen(tok[first]) - 1] = '\0';
+            const char *e = add_label(&c, tok[first]);
+            if (e != NULL) {
+                err->line = line;
+                err->message = e;
+                return false;
+            }
+            first++;
+        }
+        if (first < n) {
+            const char *e = parse_line(&c, tok + first, n - first, line);
+            if (e != NULL) {
+                err->line = line;
+                err->message = e;
+                return false;
+            }
+        }
+    }
+    prog->ops[prog->count++] = (seq_op_t){.op = SEQ_OP_END};
+
+    for (uint16_t i = 0; i < prog->count; i++) {
+        seq_op_t *op = &prog->ops[i];
+        if (c.fixups[i][0] != '\0') {
+            int l = 0;
+            while (l < c.label_count && strcmp(c.labels[l].name, c.fixups[i]) != 0) {
+                l++;
+            }
+            if (l == c.label_count) {
+                err->line = c.fixup_lines[i];
+                err->message = "undefined label";
+                return false;
+            }
+            op->target = c.labels[l].op;
+        }
+        if (op->op == SEQ_OP_SEND && i + 1 < prog->count && prog->ops[i + 1].op == SEQ_OP_WAIT) {
+            op->flags |= SEQ_F_ARM_WAIT;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Diagnostic sequence scripts. A script is plain text, one step per line,
+// '#' starts a comment and "name:" defines a label:
+//
+//   send <id> <bytes...>            transmit a raw frame (DLC = byte count)
+//   wait <id> [<prefix...>] [timeout <ms>] [else <label>]
+//                                   wait for a frame; armed before the send
+//                                   that directly precedes it. The ID must
+//                                   have an RX handler (seq_engine checks)
+//   request <bytes...> [timeout <ms>] [else <label>]
+//                                   ISO-TP request on the diagnostic link,
+//                                   "response pending" handled internally
+//   delay <us>                      wait, measured from the end of the
+//                                   previous step
+//   if frame|resp[<n>] [& <mask>] ==|!= <value> goto <label>
+//                                   branch on a byte of the last raw frame
+//                                   or ISO-TP response; a missing byte
+//                                   never equals anything
+//   goto <label>
+//   repeat <count> <label>          jump back to label count more times
+//   status <n>                      record n as the sequence result
+//   end
+//
+// IDs and bytes are hex, times and counts decimal. Without "else" a timeout
+// fails the sequence. seq_compile() validates a script once and flattens it
+// into an array of fixed-size ops with resolved jump targets.
+
+#define SEQ_MAX_OPS         64
+#define SEQ_MAX_LABELS      16
+#define SEQ_MAX_SOURCE      2048
+#define SEQ_MAX_RESPONSE    256     // longest ISO-TP response kept for branches
+
+#define SEQ_DEFAULT_TIMEOUT_MS  1000
+#define SEQ_MAX_DELAY_US        10000000
+#define SEQ_MAX_TIMEOUT_MS      60000
+
+typedef enum {
+    SEQ_OP_SEND,
+    SEQ_OP_WAIT,
+    SEQ_OP_REQUEST,
+    SEQ_OP_DELAY,
+    SEQ_OP_BRANCH,
+    SEQ_OP_GOTO,
+    SEQ_OP_REPEAT,
+    SEQ_OP_STATUS,
+    SEQ_OP_END,
+} seq_opcode_t;
+
+#define SEQ_F_ARM_WAIT  0x01    // SEND: the next op is a WAIT to register first
+#define SEQ_F_ELSE      0x02    // WAIT/REQUEST: jump to target on timeout
+#define SEQ_F_RESP      0x04    // BRANCH: test the ISO-TP response, not the frame
+#define SEQ_F_NOT_EQUAL 0x08    // BRANCH: jump when the byte differs
+
+typedef struct {
+    uint8_t op;
+    uint8_t flags;
+    uint8_t len;            // data bytes: payload or prefix
+    uint8_t mask;           // BRANCH
+    uint8_t value;          // BRANCH
+    uint16_t index;         // BRANCH: byte index
+    uint16_t target;        // jump target
+    uint32_t id;            // SEND/WAIT identifier
+    uint32_t arg;           // DELAY us, WAIT/REQUEST ms, REPEAT count, STATUS value
+    uint8_t data[8];
+} seq_op_t;
+
+typedef struct {
+    uint16_t count;
+    seq_op_t ops[SEQ_MAX_OPS];
+} seq_program_t;
+
+typedef struct {
+    int line;               // 1-based source line, 0 for whole-script errors
+    const char *message;
+} seq_error_t;
+
+// Returns false and fills err if the script is invalid. The program always
+// ends with an END op.
+bool seq_compile(const char *src, seq_program_t *prog, seq_error_t *err);
@@ -0,0 +1,168 @@
+#include "twai_tx.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bus_recovery.h"
+#include "can_backend.h"
+#include "metrics.h"
+
+#define MAX_RETRIES 3
+#define READY_TIMEOUT_MS 1000   // how long a frame is held back during recovery
+
+static const char *TAG = "TWAI_TX";
+
+static QueueHandle_t tx_queue;
+
+static TaskHandle_t tx_task;
+static esp_timer_handle_t gap_timer;
+
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+static void IRAM_ATTR gap_timer_callback(void *arg) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(tx_task, &woken);
+    if (woken) {
+        esp_timer_isr_dispatch_need_yield();
+    }
+}
+#define GAP_TIMER_DISPATCH ESP_TIMER_ISR
+#else
+static void gap_timer_callback(void *arg) {
+    xTaskNotifyGive(tx_task);
+}
+#define GAP_TIMER_DISPATCH ESP_TIMER_TASK
+#endif
+
+// Same scheme as the sequence engine: sleeps on a one-shot timer until just
+// before the deadline and spins only the last TWAI_TX_SPIN_US, so a gap is
+// never undercut and this task, which runs above the RX task and lwIP,
+// does not hold the CPU while it waits.
+static void wait_until(int64_t deadline_us) {
+    int64_t left = deadline_us - esp_timer_get_time();
+    if (left > TWAI_TX_SPIN_US) {
+        ulTaskNotifyTake(pdTRUE, 0);
+        esp_timer_start_once(gap_timer, left - TWAI_TX_SPIN_US);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    while (esp_timer_get_time() < deadline_us) {
+    }
+}
+
+static esp_err_t transmit_with_retry(const tx_frame_t *frame, uint32_t *retries) {
+    can_frame_t message = {.identifier = frame->identifier, .dlc = frame->dlc};
+    memcpy(message.data, frame->data, sizeof(message.data));
+
+    int attempts = 0;
+    esp_err_t result;
+    do {
+        // Bus-off recovery is handled by bus_recovery; hold the frame until
+        // the controller is back rather than spending retries on it.
+        if (!bus_recovery_wait_ready(READY_TIMEOUT_MS)) {
+            ESP_LOGE(TAG, "Bus not ready (%s), dropping frame 0x%03" PRIx32,
+                     bus_recovery_state_name(bus_recovery_state()), message.identifier);
+            metrics_inc(METRIC_TX_FAILURES);
+            return ESP_ERR_INVALID_STATE;
+        }
+        result = can_backend_transmit(&message, 1000);
+        if (result == ESP_OK) {
+            metrics_inc(METRIC_TX_FRAMES);
+            metrics_add(METRIC_ACCEPTED_BITS, metrics_frame_bits(message.dlc, false));
+            ESP_LOGD(TAG, "Message sent: ID=0x%03" PRIx32 ", DLC=%d, data[0]=0x%02X",
+                     message.identifier, message.dlc, message.data[0]);
+            return ESP_OK;
+        }
+
+        ESP_LOGW(TAG, "Failed to send message, error: %s. Retry %d", esp_err_to_name(result), attempts + 1);
+        attempts++;
+        (*retries)++;
+        metrics_inc(METRIC_TX_RETRIES);
+    } while (attempts < MAX_RETRIES);
+
+    ESP_LOGE(TAG, "Failed to send message after %d retries", MAX_RETRIES);
+    metrics_inc(METRIC_TX_FAILURES);
+    return result;
+}
+
+static void twai_tx_task(void *pvParameters) {
+    tx_batch_t *batch;
+    while (1) {
+        xQueueReceive(tx_queue, &batch, portMAX_DELAY);
+
+        tx_result_t *res = &batch->result;
+        int64_t prev_us = esp_timer_get_time();
+        res->err = ESP_OK;
+        for (size_t i = 0; i < batch->count; i++) {
+            const tx_frame_t *frame = &batch->frames[i];
+            wait_until(prev_us + frame->delay_us);
+
+            res->err = transmit_with_retry(frame, &res->retries);
+            if (res->err != ESP_OK) {
+                break;
+            }
+            prev_us = esp_timer_get_time();
+            if (res->frames_sent++ == 0) {
+                res->start_us = prev_us;
+            }
+            res->end_us = prev_us;
+        }
+
+        xSemaphoreGive(batch->done);
+    }
+}
+
+esp_err_t twai_tx_start(UBaseType_t priority) {
+    tx_queue = xQueueCreate(TWAI_TX_QUEUE_LEN, sizeof(tx_batch_t *));
+    if (tx_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_timer_create_args_t args = {
+        .callback = &gap_timer_callback,
+        .dispatch_method = GAP_TIMER_DISPATCH,
+        .name = "tx_gap"
+    };
+    esp_err_t err = esp_timer_create(&args, &gap_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (xTaskCreate(twai_tx_task, "TWAI_tx_task", 4096, NULL, priority, &tx_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t twai_tx_submit(tx_batch_t *batch, const tx_frame_t *frames, size_t count) {
+    batch->frames = frames;
+    batch->count = count;
+    memset(&batch->result, 0, sizeof(batch->result));
+    batch->result.queued_us = esp_timer_get_time();
+    batch->done = xSemaphoreCreateBinaryStatic(&batch->done_buf);
+
+    if (xQueueSend(tx_queue, &batch, portMAX_DELAY) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    metrics_max(METRIC_TX_QUEUE_HWM, uxQueueMessagesWaiting(tx_queue));
+    return ESP_OK;
+}
+
+esp_err_t twai_tx_wait(tx_batch_t *batch) {
+    xSemaphoreTake(batch->done, portMAX_DELAY);
+    return batch->result.err;
+}
+
+esp_err_t twai_tx_send(const tx_frame_t *frames, size_t count, tx_result_t *result) {
+    tx_batch_t batch;
+    esp_err_t err = twai_tx_submit(&batch, frames, count);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = twai_tx_wait(&batch);
+    if (result != NULL) {
+        *result = batch.result;
+    }
+    return err;
+}
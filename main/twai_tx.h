@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// TX pipeline. A single high-priority task owns can_backend_transmit();
+// callers queue batches of frames and block only on the batch's
+// completion, never on the controller. Batches are executed one at a time in submission
+// order, so sequences from different callers never interleave. Gaps
+// between frames (delay_us) are slept on an esp_timer; only the last
+// TWAI_TX_SPIN_US are busy-waited.
+
+#define TWAI_TX_QUEUE_LEN 8
+#define TWAI_TX_SPIN_US   100
+
+typedef struct {
+    uint32_t identifier;
+    uint8_t dlc;
+    uint8_t data[8];
+    uint32_t delay_us;      // minimum gap after the previous frame of the batch
+} tx_frame_t;
+
+typedef struct {
+    esp_err_t err;          // ESP_OK if every frame was sent
+    size_t frames_sent;
+    uint32_t retries;
+    int64_t queued_us;
+    int64_t start_us;       // first frame handed to the driver
+    int64_t end_us;         // last frame handed to the driver
+} tx_result_t;
+
+// Completion handle. Owned by the caller and must stay valid until
+// twai_tx_wait() returns.
+typedef struct {
+    const tx_frame_t *frames;
+    size_t count;
+    tx_result_t result;
+    SemaphoreHandle_t done;
+    StaticSemaphore_t done_buf;
+} tx_batch_t;
+
+esp_err_t twai_tx_start(UBaseType_t priority);
+
+// Queues the frames; the array must stay valid until completion.
+esp_err_t twai_tx_submit(tx_batch_t *batch, const tx_frame_t *frames, size_t count);
+
+// Blocks until the batch has been executed and returns its result code.
+esp_err_t twai_tx_wait(tx_batch_t *batch);
+
+// Submit and wait in one call. result may be NULL.
+esp_err_t twai_tx_send(const tx_frame_t *frames, size_t count, tx_result_t *result);
@@ -0,0 +1,195 @@
+var MAX_MESSAGES = 20;
+var nextSeq = null;
+var JOB_POLL_MS = 250;
+var jobWaiters = {};
+var CALIBRATION_POLL_MS = 200;
+var CALIBRATION_ACTIVE = ['end_stops', 'centre', 'configuring', 'confirming'];
+
+// The device follows the live steering angle and moves through the phases
+// on its own; the page only shows them. Updates arrive over the WebSocket,
+// or by polling /calibrate without one.
+function startCalibration() {
+  fetch('/calibrate', { method: 'POST' })
+    .then(response => response.json())
+    .then(data => {
+      showCalibration(data);
+      if (!window.WebSocket) {
+        setTimeout(pollCalibration, CALIBRATION_POLL_MS);
+      }
+    });
+}
+
+function cancelCalibration() {
+  fetch('/calibrate', { method: 'DELETE' })
+    .then(response => response.json())
+    .then(showCalibration);
+}
+
+function pollCalibration() {
+  fetch('/calibrate')
+    .then(response => response.json())
+    .then(data => {
+      showCalibration(data);
+      if (CALIBRATION_ACTIVE.indexOf(data.phase) >= 0) {
+        setTimeout(pollCalibration, CALIBRATION_POLL_MS);
+      }
+    });
+}
+
+function setStep(id, done, active) {
+  document.getElementById(id).className = done ? 'step-done' : active ? 'step-active' : '';
+}
+
+function showCalibration(c) {
+  var active = CALIBRATION_ACTIVE.indexOf(c.phase) >= 0;
+  var btn = document.getElementById('calibrateBtn');
+  btn.innerHTML = active ? 'Calibrando...' : 'Calibrar ángulo de volante';
+  btn.disabled = active;
+  document.getElementById('cancelBtn').style.display = active ? 'inline-block' : 'none';
+  document.getElementById('calibration').style.display = c.phase === 'idle' ? 'none' : 'block';
+  document.getElementById('steeringAngle').textContent = c.angle.toFixed(1) + '°';
+
+  setStep('stepLeft', c.left, c.phase === 'end_stops');
+  setStep('stepRight', c.right, c.phase === 'end_stops');
+  setStep('stepCentre', c.job !== 0, c.phase === 'centre');
+  setStep('stepConfig', c.phase === 'confirming' || c.phase === 'done', c.phase === 'configuring');
+  setStep('stepConfirm', c.phase === 'done', c.phase === 'confirming');
+
+  var box = document.getElementById('calibrationStatus');
+  if (c.phase === 'done') {
+    box.innerHTML = 'Calibración completa';
+    box.className = 'calibration-complete';
+  } else if (c.phase === 'failed') {
+    box.innerHTML = 'Calibración fallida: ' + c.error;
+    box.className = 'calibration-failed';
+  }
+  box.style.display = c.phase === 'done' || c.phase === 'failed' ? 'inline-block' : 'none';
+}
+
+// Resolves with the job once it is done: from the WebSocket job updates,
+// or by polling /jobs?id= when those do not arrive.
+function waitJob(job) {
+  if (job.state === 'done') {
+    return Promise.resolve(job);
+  }
+  return new Promise(resolve => {
+    var timer;
+    var finish = function(done) {
+      if (jobWaiters[job.id]) {
+        delete jobWaiters[job.id];
+        clearTimeout(timer);
+        resolve(done);
+      }
+    };
+    var poll = function() {
+      fetch('/jobs?id=' + job.id)
+        .then(response => response.json())
+        .then(data => {
+          if (data.state === 'done') {
+            finish(data);
+          } else {
+            timer = setTimeout(poll, JOB_POLL_MS);
+          }
+        })
+        .catch(() => { timer = setTimeout(poll, JOB_POLL_MS); });
+    };
+    jobWaiters[job.id] = finish;
+    timer = setTimeout(poll, JOB_POLL_MS);
+  });
+}
+
+function receiveJobs(jobs) {
+  jobs.forEach(job => {
+    if (job.state === 'done' && jobWaiters[job.id]) {
+      jobWaiters[job.id](job);
+    }
+  });
+}
+
+function sendStatusCheck() {
+  var btn = document.getElementById('statusBtn');
+  btn.innerHTML = 'Comprobando...';
+  btn.disabled = true;
+  fetch('/status_check', { method: 'POST' })
+    .then(response => response.json())
+    .then(waitJob)
+    .then(data => {
+      console.log(data);
+      var statusBox = document.getElementById('statusBox');
+      if (data.result !== 'ESP_OK' || data.status === 0) {
+        statusBox.innerHTML = data.nrc ? 'Petición rechazada (NRC 0x' + hex(data.nrc, 2) + ')'
+                                       : 'Sin respuesta de la centralita';
+        statusBox.className = 'status-box';
+      } else {
+        statusBox.innerHTML = 'Status ' + data.status + ' (' + Math.round(data.rtt_us / 1000) + ' ms)';
+        statusBox.className = 'status-box status-box-' + data.status;
+      }
+      statusBox.style.display = 'inline-block';
+    })
+    .finally(() => {
+      btn.innerHTML = 'Comprobar configuración de ángulo de volante';
+      btn.disabled = false;
+    });
+}
+
+function hex(n, width) {
+  return n.toString(16).toUpperCase().padStart(width, '0');
+}
+
+function addMessage(frame) {
+  var list = document.getElementById('messageList');
+  var li = document.createElement('li');
+  var text = 'ID: 0x' + hex(frame.id, 3) + ', Data: ' + frame.data;
+  if (frame.status) {
+    text += ', Status: Status ' + frame.status;
+  }
+  li.textContent = text;
+  list.appendChild(li);
+  while (list.children.length > MAX_MESSAGES) {
+    list.removeChild(list.firstChild);
+  }
+}
+
+function receiveFrames(data) {
+  data.frames.forEach(addMessage);
+  nextSeq = data.next;
+}
+
+function updateMessages() {
+  var url = nextSeq === null ? '/messages' : '/messages?since=' + nextSeq;
+  fetch(url)
+    .then(response => response.json())
+    .then(receiveFrames);
+}
+
+// Frames are pushed over a WebSocket as they arrive. After a reconnect the
+// server resumes from the last sequence number we saw, passed in the URL so
+// the recent frames are not sent again. Browsers without WebSocket support
+// fall back to polling.
+function connectPush() {
+  var query = nextSeq === null ? '' : '?since=' + nextSeq;
+  var ws = new WebSocket('ws://' + location.host + '/ws' + query);
+  ws.onmessage = function(event) {
+    var data = JSON.parse(event.data);
+    if (data.jobs) {
+      receiveJobs(data.jobs);
+    } else if (data.calibration) {
+      showCalibration(data.calibration);
+    } else {
+      receiveFrames(data);
+    }
+  };
+  ws.onclose = function() {
+    setTimeout(connectPush, 1000);
+  };
+}
+
+// A new WebSocket client is sent the job list and the calibration state,
+// so a calibration in progress shows up after a reload.
+if (window.WebSocket) {
+  connectPush();
+} else {
+  pollCalibration();
+  updateMessages();
+  setInterval(updateMessages, 5000);
+}
@@ -0,0 +1,12 @@
+#!/usr/bin/env python
+# Build step for the web UI: gzip one asset reproducibly (no file name or
+# timestamp in the header) so unchanged sources keep the same ETag.
+import gzip
+import sys
+
+src, dst = sys.argv[1], sys.argv[2]
+with open(src, 'rb') as f:
+    data = f.read()
+with open(dst, 'wb') as f:
+    with gzip.GzipFile(filename='', mode='wb', fileobj=f, compresslevel=9, mtime=0) as gz:
+        gz.write(data)
@@ -0,0 +1,78 @@
+#include "web_static.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "boot.h"
+
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
+extern const uint8_t app_js_gz_start[]     asm("_binary_app_js_gz_start");
+extern const uint8_t app_js_gz_end[]       asm("_binary_app_js_gz_end");
+extern const uint8_t style_css_gz_start[]  asm("_binary_style_css_gz_start");
+extern const uint8_t style_css_gz_end[]    asm("_binary_style_css_gz_end");
+
+typedef struct {
+    const char *uri;
+    const char *type;
+    const uint8_t *start;
+    const uint8_t *end;
+    char etag[12];      // quoted FNV-1a hash of the compressed bytes
+} web_asset_t;
+
+static web_asset_t assets[] = {
+    {"/",          "text/html; charset=UTF-8", index_html_gz_start, index_html_gz_end},
+    {"/app.js",    "application/javascript",   app_js_gz_start,     app_js_gz_end},
+    {"/style.css", "text/css",                 style_css_gz_start,  style_css_gz_end},
+};
+
+static uint32_t fnv1a(const uint8_t *p, const uint8_t *end) {
+    uint32_t h = 2166136261u;
+    while (p < end) {
+        h = (h ^ *p++) * 16777619u;
+    }
+    return h;
+}
+
+static esp_err_t asset_handler(httpd_req_t *req) {
+    const web_asset_t *asset = req->user_ctx;
+    char if_none_match[sizeof(asset->etag)];
+
+    if (asset == &assets[0]) {
+        boot_mark(BOOT_FIRST_PAGE);
+    }
+
+    // no-cache: the browser keeps its copy but revalidates, so a reload
+    // costs one 304 and a firmware update is picked up immediately.
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, asset->etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, asset->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)asset->start, asset->end - asset->start);
+}
+
+esp_err_t web_static_register(httpd_handle_t server) {
+    for (size_t i = 0; i < sizeof(assets) / sizeof(assets[0]); i++) {
+        web_asset_t *asset = &assets[i];
+        snprintf(asset->etag, sizeof(asset->etag), "\"%08" PRIx32 "\"", fnv1a(asset->start, asset->end));
+
+        httpd_uri_t uri = {
+            .uri       = asset->uri,
+            .method    = HTTP_GET,
+            .handler   = asset_handler,
+            .user_ctx  = asset
+        };
+        esp_err_t err = httpd_register_uri_handler(server, &uri);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Serves the UI assets embedded in flash at build time (main/web/*, gzip
+// compressed by the component CMakeLists). Responses point straight at
+// flash, carry Content-Encoding: gzip and an ETag, and conditional
+// requests with a matching If-None-Match get a 304.
+esp_err_t web_static_register(httpd_handle_t server);
@@ -0,0 +1,258 @@
+#include "ws_push.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "frame_json.h"
+#include "low_latency.h"
+
+#define WS_PUSH_BATCH       16
+#define WS_PUSH_BUF_SIZE    1536
+#define WS_PUSH_COALESCE_MS 20  // gather bursts into one message per client
+
+static const char *TAG = "WS_PUSH";
+
+typedef struct {
+    int fd;                     // -1 when the slot is free
+    uint32_t cursor;            // next sequence number to send
+    uint32_t event_sent[WS_PUSH_MAX_SOURCES];   // event versions the client has seen
+    volatile bool in_flight;
+    char buf[WS_PUSH_BUF_SIZE]; // owned by the in-flight send
+} ws_client_t;
+
+static httpd_handle_t ws_server;
+static const rx_ring_t *ws_ring;
+static TaskHandle_t push_task_handle;
+static SemaphoreHandle_t clients_lock;
+static ws_client_t clients[WS_PUSH_MAX_CLIENTS];
+static volatile int client_count = 0;
+static ws_push_render_fn event_render[WS_PUSH_MAX_SOURCES];
+static _Atomic uint32_t event_version[WS_PUSH_MAX_SOURCES];
+static _Atomic int event_source_count;     // sources may be added after start
+
+static void add_client(int fd, uint32_t cursor) {
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    ws_client_t *free_slot = NULL;
+    for (int i = 0; i < WS_PUSH_MAX_CLIENTS; i++) {
+        if (clients[i].fd == fd) {
+            free_slot = &clients[i];
+            break;
+        }
+        if (clients[i].fd < 0 && free_slot == NULL) {
+            free_slot = &clients[i];
+        }
+    }
+    if (free_slot != NULL) {
+        if (free_slot->fd < 0) {
+            client_count++;
+        }
+        free_slot->fd = fd;
+        free_slot->cursor = cursor;
+        for (int s = 0; s < WS_PUSH_MAX_SOURCES; s++) {
+            free_slot->event_sent[s] = atomic_load(&event_version[s]) - 1;
+        }
+        free_slot->in_flight = false;
+        ESP_LOGI(TAG, "Client %d connected (%d total)", fd, client_count);
+    } else {
+        ESP_LOGW(TAG, "Rejecting client %d, all %d slots in use", fd, WS_PUSH_MAX_CLIENTS);
+        httpd_sess_trigger_close(ws_server, fd);
+    }
+    xSemaphoreGive(clients_lock);
+    xTaskNotifyGive(push_task_handle);
+}
+
+static void set_cursor(int fd, uint32_t since) {
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    for (int i = 0; i < WS_PUSH_MAX_CLIENTS; i++) {
+        if (clients[i].fd == fd) {
+            clients[i].cursor = since;
+        }
+    }
+    xSemaphoreGive(clients_lock);
+    xTaskNotifyGive(push_task_handle);
+}
+
+static esp_err_t ws_handler(httpd_req_t *req) {
+    int fd = httpd_req_to_sockfd(req);
+    if (req->method == HTTP_GET) {
+        // Resuming in the handshake, rather than with a message once
+        // connected, keeps the backlog from being sent before the client
+        // can say it has already seen it.
+        char query[32], since[12];
+        uint32_t cursor = rx_ring_head(ws_ring) - WS_PUSH_BACKLOG;
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "since", since, sizeof(since)) == ESP_OK) {
+            cursor = (uint32_t)strtoul(since, NULL, 10);
+        }
+        add_client(fd, cursor);
+        return ESP_OK;
+    }
+
+    uint8_t payload[48];
+    httpd_ws_frame_t frame = {0};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (frame.len >= sizeof(payload)) {
+        // Not one of ours, and the server cannot read a frame in parts:
+        // close the session rather than leave the payload unread.
+        ESP_LOGW(TAG, "Closing client %d after a %u-byte message", fd, (unsigned)frame.len);
+        return ESP_FAIL;
+    }
+    frame.payload = payload;
+    err = httpd_ws_recv_frame(req, &frame, sizeof(payload) - 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (frame.type != HTTPD_WS_TYPE_TEXT) {
+        return ESP_OK;
+    }
+    payload[frame.len] = '\0';
+
+    unsigned long since;
+    if (sscanf((const char *)payload, "{\"since\":%lu}", &since) == 1) {
+        set_cursor(fd, (uint32_t)since);
+    }
+    return ESP_OK;
+}
+
+static void send_done(esp_err_t err, int fd, void *arg) {
+    ws_client_t *c = arg;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Send to client %d failed: %s", fd, esp_err_to_name(err));
+    }
+    c->in_flight = false;
+    xTaskNotifyGive(push_task_handle);
+}
+
+static bool send_text(ws_client_t *c, size_t len) {
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)c->buf,
+        .len = len,
+    };
+    c->in_flight = true;
+    if (httpd_ws_send_data_async(ws_server, c->fd, &frame, send_done, c) != ESP_OK) {
+        c->in_flight = false;
+        return false;
+    }
+    return true;
+}
+
+// Sends a pending event or the next batch of frames to one client.
+// Returns true if it still has frames waiting after this send.
+static bool service_client(ws_client_t *c, uint32_t head) {
+    if (httpd_ws_get_fd_info(ws_server, c->fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+        ESP_LOGI(TAG, "Client %d disconnected", c->fd);
+        c->fd = -1;
+        client_count--;
+        return false;
+    }
+    if (c->in_flight) {
+        return false;
+    }
+    for (int s = 0; s < event_source_count; s++) {
+        uint32_t version = atomic_load(&event_version[s]);
+        if (c->event_sent[s] != version) {
+            size_t len = event_render[s](c->buf, sizeof(c->buf));
+            if (len == 0 || send_text(c, len)) {
+                c->event_sent[s] = version;
+            }
+            return true;
+        }
+    }
+    if (c->cursor == head) {
+        return false;
+    }
+
+    can_record_t recs[WS_PUSH_BATCH];
+    uint32_t cursor = c->cursor;
+    size_t n = rx_ring_read(ws_ring, &cursor, recs, WS_PUSH_BATCH);
+    size_t len = frame_json_list(c->buf, sizeof(c->buf), recs, n, &cursor);
+    if (!send_text(c, len)) {
+        return false;
+    }
+    c->cursor = cursor;
+    return cursor != head;
+}
+
+static void ws_push_task(void *pvParameters) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(WS_PUSH_COALESCE_MS));
+
+        bool pending;
+        do {
+            pending = false;
+            uint32_t head = rx_ring_head(ws_ring);
+            xSemaphoreTake(clients_lock, portMAX_DELAY);
+            for (int i = 0; i < WS_PUSH_MAX_CLIENTS; i++) {
+                if (clients[i].fd >= 0 && service_client(&clients[i], head)) {
+                    pending = true;
+                }
+            }
+            xSemaphoreGive(clients_lock);
+            // Clients with a send in flight are picked up again from
+            // send_done(); the rest drain here.
+        } while (pending);
+    }
+}
+
+LOW_LATENCY_IRAM void ws_push_notify(void) {
+    if (client_count > 0) {
+        xTaskNotifyGive(push_task_handle);
+    }
+}
+
+int ws_push_add_event_source(ws_push_render_fn render) {
+    int source = atomic_load(&event_source_count);
+    if (source == WS_PUSH_MAX_SOURCES) {
+        return -1;
+    }
+    event_render[source] = render;
+    atomic_store(&event_source_count, source + 1);
+    if (client_count > 0) {
+        xTaskNotifyGive(push_task_handle);
+    }
+    return source;
+}
+
+void ws_push_event(int source) {
+    if (source < 0 || source >= event_source_count) {
+        return;
+    }
+    atomic_fetch_add(&event_version[source], 1);
+    if (client_count > 0) {
+        xTaskNotifyGive(push_task_handle);
+    }
+}
+
+esp_err_t ws_push_start(httpd_handle_t server, const rx_ring_t *ring, UBaseType_t priority) {
+    ws_server = server;
+    ws_ring = ring;
+    for (int i = 0; i < WS_PUSH_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+    clients_lock = xSemaphoreCreateMutex();
+    if (clients_lock == NULL ||
+        xTaskCreate(ws_push_task, "ws_push_task", 4096, NULL, priority, &push_task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    httpd_uri_t uri_ws = {
+        .uri          = "/ws",
+        .method       = HTTP_GET,
+        .handler      = ws_handler,
+        .user_ctx     = NULL,
+        .is_websocket = true
+    };
+    return httpd_register_uri_handler(server, &uri_ws);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "rx_ring.h"
+
+// WebSocket push of received frames on /ws. Each client has its own cursor
+// into the RX ring and at most one send in flight: a slow client falls
+// behind (and eventually sees a gap in sequence numbers) without holding
+// up the others. A client resumes after reconnecting by opening
+// /ws?since=<seq>; otherwise it starts with the most recent frames.
+// {"since":<seq>} sent over an open connection moves its cursor.
+//
+// Besides frames, clients receive the state of other resources (the
+// diagnostic jobs, the calibration): after ws_push_event() each client is
+// sent the source's latest rendering once, ahead of pending frames.
+// Intermediate states may be skipped, never the last one.
+//
+// Needs CONFIG_HTTPD_WS_SUPPORT (set in sdkconfig.defaults).
+
+#define WS_PUSH_MAX_CLIENTS 4   // matches the softAP max_connection
+#define WS_PUSH_BACKLOG     20  // frames sent to a client that does not resume
+#define WS_PUSH_MAX_SOURCES 4
+
+// Writes the event payload into buf. Returns its length, 0 if it does not fit.
+typedef size_t (*ws_push_render_fn)(char *buf, size_t cap);
+
+esp_err_t ws_push_start(httpd_handle_t server, const rx_ring_t *ring, UBaseType_t priority);
+
+// Called by the RX task after pushing to the ring. Cheap when no client is
+// connected.
+void ws_push_notify(void);
+
+// Adds an event source and returns its handle for ws_push_event(), or -1
+// if there is no room. Safe before or after ws_push_start(); clients
+// already connected are sent its first rendering. The boot order relies on
+// this (calibration_init(), diag_jobs_start()).
+int ws_push_add_event_source(ws_push_render_fn render);
+
+// Marks the event source as changed. Cheap when no client is connected.
+void ws_push_event(int source);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "can_backend.h"
+#include "isotp.h"
+#include "rx_path.h"
+#include "rx_ring.h"
+
+// Host micro-benchmarks for the firmware hot paths. The firmware sources
+// under main/ are compiled as they are against shim/, a single-threaded
+// stand-in for the parts of ESP-IDF and FreeRTOS they use. The bus, the TX
+// task and the steering ECU are replaced by an in-process model (bus.c) that
+// answers synchronously, so a diagnostic sequence runs end to end in one
+// thread with no waiting.
+
+#define BENCH_BITRATE       500000
+#define BENCH_GATEWAY_TX_ID 0x710
+
+// --- In-process bus (bus.c) ---
+
+extern rx_ring_t bench_ring;
+extern isotp_link_t bench_diag_link;
+
+// Sets up the RX path, the diagnostic link and the sequence engine with the
+// firmware's handler table and built-in sequences.
+void bench_bus_init(void);
+
+// One frame through rx_process_frame(), received now.
+void bench_rx_frame(const can_frame_t *frame);
+
+// Frames on the bus in either direction since start-up.
+uint64_t bench_bus_frames(void);
+
+// Other ECUs' broadcasts received ahead of each frame the steering ECU
+// sends, to run sequences on a loaded bus. 0 by default.
+void bench_bus_set_background(unsigned per_frame);
+
+extern const char bench_status_check_script[];
+
+// --- Heap accounting (idf.c) ---
+
+// Allocations made by the firmware code since start-up (malloc, calloc and
+// realloc of a NULL pointer).
+uint64_t bench_allocations(void);
+
+int64_t bench_now_ns(void);
+
+// --- Cases (cases.c) ---
+
+typedef struct bench_case bench_case_t;
+
+struct bench_case {
+    const char *name;
+    const char *unit;           // what one op is: "frame", "request", "run"
+    // Builds the input. Called once, outside the measurement.
+    void (*prepare)(const bench_case_t *c);
+    // Performs ops operations and returns the bus frames they involved.
+    uint64_t (*run)(const bench_case_t *c, uint64_t ops);
+    int mix;
+    size_t size;
+};
+
+extern const bench_case_t bench_cases[];
+extern const size_t bench_case_count;
@@ -0,0 +1,241 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ecu_decode.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "resp_match.h"
+#include "rx_path.h"
+#include "seq_engine.h"
+#include "twai_tx.h"
+
+#define DIAG_FRAME_TIMEOUT_MS 1000
+
+// Built-in sequences from main/main.c
+static const char angle_config_script[] =
+    "request 14 FF 00\n"
+    "request 31 01 00\n"
+    "request 31 01 01\n";
+
+const char bench_status_check_script[] =
+    "request 10 C0\n"
+    "request 21 80\n"
+    "request 21 03\n"
+    "request 21 04\n"
+    "request 21 01\n"
+    "if resp[0] != 61 goto done\n"
+    "if resp[1] != 01 goto done\n"
+    "if resp[20] != 00 goto done\n"
+    "if resp[22] & 0F == 0C goto status4\n"
+    "status 3\n"
+    "end\n"
+    "status4: status 4\n"
+    "done: end\n";
+
+// Raw frames only: 64 TesterPresent exchanges as single frames, so the
+// scheduler's own cost dominates.
+static const char tester_present_script[] =
+    "loop: send 742 02 3E 00\n"
+    "wait 762 02 7E\n"
+    "repeat 63 loop\n"
+    "end\n";
+
+// Raw wait on the gateway's reply ID, which is dispatched but not stored
+static const char gateway_script[] =
+    "send 710 02 3E 00\n"
+    "wait 77A 02 7E\n"
+    "status 1\n"
+    "end\n";
+
+// 0x123 has no RX handler, so this wait must be refused when compiled
+static const char unreceived_wait_script[] =
+    "send 710 02 3E 00\n"
+    "wait 123\n"
+    "end\n";
+
+static rx_ring_slot_t ring_storage[RX_RING_CAPACITY];
+rx_ring_t bench_ring;
+isotp_link_t bench_diag_link;
+static uint64_t bus_frames;
+static unsigned background_per_frame;
+static uint32_t background_count;
+
+void bench_rx_frame(const can_frame_t *frame) {
+    rx_process_frame(frame, esp_timer_get_time());
+}
+
+uint64_t bench_bus_frames(void) {
+    return bus_frames;
+}
+
+void bench_bus_set_background(unsigned per_frame) {
+    background_per_frame = per_frame;
+}
+
+// Steering angle and wheel speed broadcasts, as other ECUs send them
+static void send_background(void) {
+    for (unsigned i = 0; i < background_per_frame; i++) {
+        can_frame_t frame = {
+            .identifier = (background_count++ & 1) ? ECU_WHEEL_SPEED_ID : ECU_STEERING_ANGLE_ID,
+            .dlc = 8,
+            .data = {(uint8_t)background_count, 0x01, 0x20, 0x00, 0x40, 0x02, 0x00, 0x10},
+        };
+        bus_frames++;
+        bench_rx_frame(&frame);
+    }
+}
+
+// --- Steering ECU: ISO-TP server on 0x742/0x762 reporting Status 4 ---
+
+static uint8_t ecu_resp[64];
+static size_t ecu_resp_len;
+static size_t ecu_resp_sent;
+static uint8_t ecu_sn;
+
+static void ecu_send(const uint8_t *bytes, size_t len) {
+    send_background();
+    can_frame_t frame = {.identifier = DIAG_RX_ID, .dlc = 8};
+    memcpy(frame.data, bytes, len);
+    bus_frames++;
+    bench_rx_frame(&frame);
+}
+
+static size_t ecu_answer(const uint8_t *req, size_t len, uint8_t *resp) {
+    switch (req[0]) {
+    case 0x10:      // StartDiagnosticSession
+    case 0x3E:      // TesterPresent
+        resp[0] = req[0] + 0x40;
+        resp[1] = len > 1 ? req[1] : 0;
+        return 2;
+    case 0x14:      // ClearDiagnosticInformation
+        resp[0] = 0x54;
+        return 1;
+    case 0x31:      // StartRoutineByLocalIdentifier
+        resp[0] = 0x71;
+        resp[1] = len > 1 ? req[1] : 0;
+        resp[2] = len > 2 ? req[2] : 0;
+        return 3;
+    case 0x21:      // ReadDataByLocalIdentifier
+        memset(resp, 0x11, 26);
+        resp[0] = 0x61;
+        resp[1] = len > 1 ? req[1] : 0;
+        if (resp[1] != 0x01) {
+            return 6;
+        }
+        resp[20] = 0x00;
+        resp[22] = 0x8C;    // Status 4
+        return 26;
+    default:
+        resp[0] = 0x7F;
+        resp[1] = req[0];
+        resp[2] = 0x11;     // serviceNotSupported
+        return 3;
+    }
+}
+
+static void ecu_send_consecutive(uint8_t block_size) {
+    for (unsigned block = 0; ecu_resp_sent < ecu_resp_len && (block_size == 0 || block < block_size); block++) {
+        uint8_t cf[8] = {0x20 | ecu_sn};
+        size_t n = ecu_resp_len - ecu_resp_sent < 7 ? ecu_resp_len - ecu_resp_sent : 7;
+        memcpy(&cf[1], &ecu_resp[ecu_resp_sent], n);
+        ecu_send(cf, 8);
+        ecu_resp_sent += n;
+        ecu_sn = (ecu_sn + 1) & 0x0F;
+    }
+}
+
+static void ecu_receive(const tx_frame_t *frame) {
+    uint8_t pci = frame->data[0] >> 4;
+    if (pci == 0x3) {
+        ecu_send_consecutive(frame->data[1]);
+        return;
+    }
+    if (pci != 0x0 || (frame->data[0] & 0x0F) == 0) {
+        return;
+    }
+
+    ecu_resp_len = ecu_answer(&frame->data[1], frame->data[0] & 0x0F, ecu_resp);
+    uint8_t out[8] = {0};
+    if (ecu_resp_len <= 7) {
+        out[0] = (uint8_t)ecu_resp_len;
+        memcpy(&out[1], ecu_resp, ecu_resp_len);
+        ecu_send(out, 8);
+        return;
+    }
+    out[0] = 0x10 | (uint8_t)(ecu_resp_len >> 8);
+    out[1] = (uint8_t)ecu_resp_len;
+    memcpy(&out[2], ecu_resp, 6);
+    ecu_resp_sent = 6;
+    ecu_sn = 1;
+    ecu_send(out, 8);
+}
+
+// --- Gateway: answers TesterPresent on 0x710/0x77A ---
+
+static void gateway_receive(const tx_frame_t *frame) {
+    if (frame->data[0] == 0x02 && frame->data[1] == 0x3E) {
+        send_background();
+        can_frame_t reply = {.identifier = ECU_GATEWAY_DIAG_RX_ID, .dlc = 8, .data = {0x02, 0x7E, frame->data[2]}};
+        bus_frames++;
+        bench_rx_frame(&reply);
+    }
+}
+
+// Stands in for the TX task and the driver: frames reach the ECU at once
+// and its answers go through the RX path before this returns.
+esp_err_t twai_tx_send(const tx_frame_t *frames, size_t count, tx_result_t *result) {
+    int64_t now_us = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        bus_frames++;
+        metrics_inc(METRIC_TX_FRAMES);
+        if (frames[i].identifier == DIAG_TX_ID) {
+            ecu_receive(&frames[i]);
+        } else if (frames[i].identifier == BENCH_GATEWAY_TX_ID) {
+            gateway_receive(&frames[i]);
+        }
+    }
+    *result = (tx_result_t){
+        .err = ESP_OK,
+        .frames_sent = count,
+        .queued_us = now_us,
+        .start_us = now_us,
+        .end_us = now_us,
+    };
+    return ESP_OK;
+}
+
+static void check(esp_err_t err, const char *what) {
+    if (err != ESP_OK) {
+        fprintf(stderr, "%s failed: %s\n", what, esp_err_to_name(err));
+        exit(1);
+    }
+}
+
+void bench_bus_init(void) {
+    rx_ring_init(&bench_ring, ring_storage, RX_RING_CAPACITY);
+    check(ecu_decode_init(), "ecu_decode_init");
+    check(resp_match_init(), "resp_match_init");
+    check(rx_path_init(&bench_ring, &bench_diag_link), "rx_path_init");
+
+    isotp_config_t diag_link_config = {
+        .tx_id = DIAG_TX_ID,
+        .rx_id = DIAG_RX_ID,
+        .block_size = 16,
+        .st_min = 0,
+        .padding = 0x00,
+        .timeout_ms = DIAG_FRAME_TIMEOUT_MS,
+        .transmit = twai_tx_send,
+    };
+    check(isotp_init(&bench_diag_link, &diag_link_config), "isotp_init");
+    check(seq_engine_init(&bench_diag_link), "seq_engine_init");
+    check(seq_define("angle_config", angle_config_script), "seq_define angle_config");
+    check(seq_define("status_check", bench_status_check_script), "seq_define status_check");
+    check(seq_define("tester_x64", tester_present_script), "seq_define tester_x64");
+    check(seq_define("gateway_wait", gateway_script), "seq_define gateway_wait");
+    if (seq_define("unreceived_wait", unreceived_wait_script) == ESP_OK) {
+        fprintf(stderr, "seq_define accepted a wait on an ID without an RX handler\n");
+        exit(1);
+    }
+}
@@ -0,0 +1,205 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ecu_decode.h"
+#include "frame_json.h"
+#include "seq_engine.h"
+#include "seq_script.h"
+
+// Same sizes as main/main.c (MAX_DISPLAYED_MESSAGES and the /messages
+// buffer) and main/ws_push.c (WS_PUSH_BATCH, WS_PUSH_BUF_SIZE)
+#define MESSAGES_COUNT  20
+#define MESSAGES_BUF    2048
+#define WS_BATCH        16
+#define WS_BUF          1536
+
+// Traffic reaching the RX task
+enum {
+    MIX_DIAG,       // steering ECU replies only, all stored, half carry a status
+    MIX_VEHICLE,    // what the default filter lets through on a car: the
+                    // 100 Hz broadcasts with an occasional ECU reply
+    MIX_BUS,        // the whole bus (CAPTURE_ACCEPT_ALL): random identifiers,
+                    // 1 in 32 frames for a handler
+};
+
+static can_frame_t *stream;
+static size_t stream_len;
+static size_t stream_pos;
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static void make_frame(can_frame_t *f, uint32_t id) {
+    f->identifier = id;
+    f->flags = 0;
+    f->dlc = 8;
+    for (int i = 0; i < 8; i++) {
+        f->data[i] = (uint8_t)rng();
+    }
+}
+
+static void make_reply(can_frame_t *f, size_t i) {
+    make_frame(f, DIAG_RX_ID);
+    if (i % 2 == 0) {
+        f->data[0] = 0x23;      // status frame
+        f->data[1] = 0x00;
+        f->data[3] = (i % 4 == 0) ? 0x8C : 0x83;
+    }
+}
+
+static void prepare_stream(const bench_case_t *c) {
+    free(stream);
+    stream = malloc(c->size * sizeof(*stream));
+    if (stream == NULL) {
+        fprintf(stderr, "out of memory for %zu frames\n", c->size);
+        exit(1);
+    }
+    stream_len = c->size;
+    stream_pos = 0;
+    rng_state = 1;
+    static const uint32_t handled[] = {
+        DIAG_RX_ID, ECU_STEERING_ANGLE_ID, ECU_WHEEL_SPEED_ID, ECU_GATEWAY_DIAG_RX_ID, ECU_ABS_DIAG_RX_ID,
+    };
+    for (size_t i = 0; i < c->size; i++) {
+        switch (c->mix) {
+        case MIX_DIAG:
+            make_reply(&stream[i], i);
+            break;
+        case MIX_VEHICLE:
+            if (i % 64 == 63) {
+                make_reply(&stream[i], i);
+            } else {
+                make_frame(&stream[i], i % 2 ? ECU_WHEEL_SPEED_ID : ECU_STEERING_ANGLE_ID);
+            }
+            break;
+        case MIX_BUS:
+            if (i % 32 == 0) {
+                make_frame(&stream[i], handled[(i / 32) % (sizeof(handled) / sizeof(handled[0]))]);
+            } else {
+                make_frame(&stream[i], rng() & 0x7FF);
+            }
+            break;
+        }
+    }
+}
+
+static uint64_t run_rx(const bench_case_t *c, uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        bench_rx_frame(&stream[stream_pos]);
+        if (++stream_pos == stream_len) {
+            stream_pos = 0;
+        }
+    }
+    return ops;
+}
+
+// Fills the ring with steering ECU replies, so it is at capacity
+static void prepare_ring(const bench_case_t *c) {
+    can_record_t rec = {.identifier = DIAG_RX_ID, .dlc = 8};
+    for (size_t i = 0; i < RX_RING_CAPACITY; i++) {
+        rec.timestamp_us = (int64_t)i * 1000;
+        rec.data[0] = (i % 2 == 0) ? 0x23 : 0x02;
+        rec.data[3] = 0x8C;
+        rec.status = (i % 2 == 0) ? 4 : 0;
+        rx_ring_push(&bench_ring, &rec);
+    }
+}
+
+static uint64_t run_ring_push(const bench_case_t *c, uint64_t ops) {
+    can_record_t rec = {.identifier = DIAG_RX_ID, .dlc = 8, .data = {0x23, 0x00, 0x00, 0x8C}};
+    for (uint64_t i = 0; i < ops; i++) {
+        rec.timestamp_us = (int64_t)i;
+        rx_ring_push(&bench_ring, &rec);
+    }
+    return ops;
+}
+
+// The newest records, as a reader that has fallen behind gets them
+static uint64_t run_ring_read(const bench_case_t *c, uint64_t ops) {
+    can_record_t recs[MESSAGES_COUNT];
+    size_t total = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        uint32_t cursor = rx_ring_head(&bench_ring) - c->size;
+        total += rx_ring_read(&bench_ring, &cursor, recs, c->size);
+    }
+    return total;
+}
+
+// messages_handler() in main/main.c and a ws_push.c batch, without the send
+static uint64_t run_json(const bench_case_t *c, uint64_t ops) {
+    static char buf[MESSAGES_BUF];
+    can_record_t recs[MESSAGES_COUNT];
+    size_t cap = c->mix == 0 ? MESSAGES_BUF : WS_BUF;
+    size_t total = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        uint32_t cursor = rx_ring_head(&bench_ring) - c->size;
+        size_t count = rx_ring_read(&bench_ring, &cursor, recs, c->size);
+        if (frame_json_list(buf, cap, recs, count, &cursor) == 0) {
+            fprintf(stderr, "%s: rendering failed\n", c->name);
+            exit(1);
+        }
+        total += count;
+    }
+    return total;
+}
+
+static uint64_t run_compile(const bench_case_t *c, uint64_t ops) {
+    static seq_program_t prog;
+    seq_error_t err;
+    for (uint64_t i = 0; i < ops; i++) {
+        if (!seq_compile(bench_status_check_script, &prog, &err)) {
+            fprintf(stderr, "%s: line %d: %s\n", c->name, err.line, err.message);
+            exit(1);
+        }
+    }
+    return 0;
+}
+
+static const char *const sequence_names[] = {"status_check", "angle_config", "tester_x64", "gateway_wait"};
+
+static uint64_t run_sequence(const bench_case_t *c, uint64_t ops) {
+    const char *name = sequence_names[c->mix];
+    uint64_t frames = bench_bus_frames();
+    bench_bus_set_background((unsigned)c->size);
+    for (uint64_t i = 0; i < ops; i++) {
+        seq_result_t result;
+        if (seq_run(name, &result) != ESP_OK) {
+            fprintf(stderr, "%s: %s\n", c->name, esp_err_to_name(result.err));
+            exit(1);
+        }
+        if ((c->mix == 0 && result.status != 4) || (c->mix == 3 && result.status != 1)) {
+            fprintf(stderr, "%s: unexpected status %d\n", c->name, result.status);
+            exit(1);
+        }
+    }
+    bench_bus_set_background(0);
+    return bench_bus_frames() - frames;
+}
+
+#define RX_CASES(mix_name, mix) \
+    {"rx/" mix_name "/1k", "frame", prepare_stream, run_rx, mix, 1000}, \
+    {"rx/" mix_name "/16k", "frame", prepare_stream, run_rx, mix, 16000}, \
+    {"rx/" mix_name "/256k", "frame", prepare_stream, run_rx, mix, 256000}
+
+const bench_case_t bench_cases[] = {
+    RX_CASES("diag", MIX_DIAG),
+    RX_CASES("vehicle", MIX_VEHICLE),
+    RX_CASES("bus", MIX_BUS),
+    {"ring/push_full", "frame", prepare_ring, run_ring_push, 0, 0},
+    {"ring/read_20", "request", prepare_ring, run_ring_read, 0, MESSAGES_COUNT},
+    {"json/messages_20", "request", prepare_ring, run_json, 0, MESSAGES_COUNT},
+    {"json/ws_batch_16", "request", prepare_ring, run_json, 1, WS_BATCH},
+    {"seq/compile", "script", NULL, run_compile, 0, 0},
+    {"seq/status_check", "run", NULL, run_sequence, 0, 0},
+    {"seq/status_check/load", "run", NULL, run_sequence, 0, 4},
+    {"seq/angle_config", "run", NULL, run_sequence, 1, 0},
+    {"seq/tester_x64", "run", NULL, run_sequence, 2, 0},
+    {"seq/gateway_wait", "run", NULL, run_sequence, 3, 0},
+};
+
+const size_t bench_case_count = sizeof(bench_cases) / sizeof(bench_cases[0]);
@@ -0,0 +1,314 @@
+#include "bench.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "boot.h"
+#include "capture.h"
+#include "low_latency.h"
+#include "metrics.h"
+#include "ws_push.h"
+
+// Implementations behind shim/: single-threaded FreeRTOS objects that never
+// block, a monotonic esp_timer clock, an empty NVS and a web server that is
+// never started. Plus the firmware modules the compiled sources call into
+// but that are not benchmarked.
+
+// --- Heap: malloc and friends are wrapped at link time (CMakeLists.txt) ---
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+static uint64_t allocations;
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    allocations++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    if (p == NULL) {
+        allocations++;
+    }
+    return __real_realloc(p, size);
+}
+
+uint64_t bench_allocations(void) {
+    return allocations;
+}
+
+int64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// --- esp_err, esp_timer ---
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK:                    return "ESP_OK";
+    case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+    default:                        return "ESP_FAIL";
+    }
+}
+
+int64_t esp_timer_get_time(void) {
+    return bench_now_ns() / 1000;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+    static int timer;
+    *out = (esp_timer_handle_t)&timer;
+    return ESP_OK;
+}
+
+// The delay step then spins until its deadline, which the benchmark
+// sequences never use.
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return ESP_OK;
+}
+
+// --- FreeRTOS ---
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return NULL;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout) {
+    return 1;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return pdPASS;
+}
+
+struct QueueDefinition {
+    size_t length;
+    size_t item_size;
+    size_t head;
+    size_t count;
+    uint8_t storage[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    QueueHandle_t q = calloc(1, sizeof(*q) + length * item_size);
+    if (q != NULL) {
+        q->length = length;
+        q->item_size = item_size;
+    }
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t timeout) {
+    if (q->count == q->length) {
+        return pdFALSE;
+    }
+    memcpy(&q->storage[((q->head + q->count) % q->length) * q->item_size], item, q->item_size);
+    q->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t timeout) {
+    if (q->count == 0) {
+        return pdFALSE;
+    }
+    memcpy(item, &q->storage[q->head * q->item_size], q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+    q->head = q->count = 0;
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    return q->count;
+}
+
+struct SemaphoreDefinition {
+    bool taken;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return calloc(1, sizeof(struct SemaphoreDefinition));
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t timeout) {
+    if (sem->taken) {
+        return pdFALSE;
+    }
+    sem->taken = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    sem->taken = false;
+    return pdTRUE;
+}
+
+struct EventGroupDef_t {
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    return calloc(1, sizeof(struct EventGroupDef_t));
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t timeout) {
+    EventBits_t current = group->bits;
+    bool satisfied = all ? (current & bits) == bits : (current & bits) != 0;
+    if (satisfied && clear) {
+        group->bits &= ~bits;
+    }
+    return current;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    return group->bits |= bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    return group->bits;
+}
+
+// --- NVS: always empty ---
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out) {
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out, size_t *len) {
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_find(const char *part, const char *ns, nvs_type_t type, nvs_iterator_t *it) {
+    *it = NULL;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *it) {
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_info(nvs_iterator_t it, nvs_entry_info_t *out) {
+    return ESP_ERR_INVALID_ARG;
+}
+
+void nvs_release_iterator(nvs_iterator_t it) {
+}
+
+// --- HTTP server: handlers are compiled in but never registered ---
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t server, const httpd_uri_t *uri) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t len) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *req, const char *str) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t code, const char *msg) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_resp_send_500(httpd_req_t *req) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *req, char *buf, size_t len) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t len) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t len) {
+    return HTTPD_SOCK_ERR_TIMEOUT;
+}
+
+// --- Firmware modules outside the benchmark ---
+
+_Atomic uint32_t metrics_counters[METRIC_COUNTER_COUNT];
+_Atomic uint32_t metrics_gauges[METRIC_GAUGE_COUNT];
+metrics_hist_t metrics_hists[METRIC_HIST_COUNT];
+
+void metrics_register_seq(metrics_seq_t *seq) {
+}
+
+bool boot_gate(httpd_req_t *req, EventBits_t bits) {
+    return true;
+}
+
+// No capture running and no WebSocket client, so both return at once as
+// they do on the device.
+void capture_record(uint32_t identifier, uint8_t flags, uint8_t dlc, const uint8_t *data, int64_t timestamp_us) {
+}
+
+void ws_push_notify(void) {
+}
+
+void low_latency_observe_send(int64_t late_us) {
+}
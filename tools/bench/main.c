@@ -0,0 +1,208 @@
+#include "bench.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+
+// Micro-benchmarks for the firmware hot paths, run on the host:
+//   fw_bench [--filter SUBSTR] [--min-ms N] [--repeat N]
+//            [--save FILE] [--compare FILE [--threshold PCT]] [--list]
+// Each case is calibrated until one repetition takes at least --min-ms and
+// the fastest of --repeat repetitions is reported. --save writes the results
+// as a baseline; --compare reads one and flags cases that got slower by more
+// than --threshold percent or that allocate more, exiting with 1 if any did.
+
+#define MAX_BASELINE 64
+
+typedef struct {
+    char name[48];
+    double ns_op;
+    double allocs_op;
+} result_t;
+
+static result_t baseline[MAX_BASELINE];
+static size_t baseline_count;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--filter SUBSTR] [--min-ms N] [--repeat N]\n"
+            "          [--save FILE] [--compare FILE [--threshold PCT]] [--list]\n",
+            prog);
+    exit(2);
+}
+
+static bool load_baseline(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    char line[160];
+    while (fgets(line, sizeof(line), f) != NULL && baseline_count < MAX_BASELINE) {
+        result_t *r = &baseline[baseline_count];
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%47s %lf %lf", r->name, &r->ns_op, &r->allocs_op) == 3) {
+            baseline_count++;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static const result_t *find_baseline(const char *name) {
+    for (size_t i = 0; i < baseline_count; i++) {
+        if (strcmp(baseline[i].name, name) == 0) {
+            return &baseline[i];
+        }
+    }
+    return NULL;
+}
+
+// Time of one repetition of ops operations, in nanoseconds
+static int64_t time_ops(const bench_case_t *c, uint64_t ops, uint64_t *frames) {
+    int64_t start = bench_now_ns();
+    *frames = c->run(c, ops);
+    return bench_now_ns() - start;
+}
+
+int main(int argc, char **argv) {
+    const char *filter = NULL;
+    const char *save_path = NULL;
+    const char *compare_path = NULL;
+    int64_t min_ns = 200 * 1000000LL;
+    int repeat = 5;
+    double threshold = 10.0;
+    bool list = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--list") == 0) {
+            list = true;
+            continue;
+        }
+        if (value == NULL) {
+            usage(argv[0]);
+        }
+        i++;
+        if (strcmp(arg, "--filter") == 0) {
+            filter = value;
+        } else if (strcmp(arg, "--min-ms") == 0) {
+            min_ns = atoll(value) * 1000000LL;
+        } else if (strcmp(arg, "--repeat") == 0) {
+            repeat = atoi(value);
+        } else if (strcmp(arg, "--save") == 0) {
+            save_path = value;
+        } else if (strcmp(arg, "--compare") == 0) {
+            compare_path = value;
+        } else if (strcmp(arg, "--threshold") == 0) {
+            threshold = atof(value);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (min_ns <= 0 || repeat <= 0) {
+        usage(argv[0]);
+    }
+    if (list) {
+        for (size_t i = 0; i < bench_case_count; i++) {
+            printf("%s\n", bench_cases[i].name);
+        }
+        return 0;
+    }
+    if (compare_path != NULL && !load_baseline(compare_path)) {
+        return 2;
+    }
+    FILE *save = NULL;
+    if (save_path != NULL) {
+        save = fopen(save_path, "w");
+        if (save == NULL) {
+            perror(save_path);
+            return 2;
+        }
+        fprintf(save, "# fw_bench: name ns/op allocs/op\n");
+    }
+
+    bench_bus_init();
+    // Fastest possible rate on the bus: back-to-back 8-byte standard frames
+    double bus_max_fps = (double)BENCH_BITRATE / metrics_frame_bits(8, false);
+
+    printf("%-24s %12s %10s %10s %12s %10s", "case", "ns/op", "ns/frame", "allocs/op", "ops/s", "x bus");
+    if (compare_path != NULL) {
+        printf(" %9s", "vs base");
+    }
+    printf("\n");
+
+    int regressions = 0;
+    for (size_t i = 0; i < bench_case_count; i++) {
+        const bench_case_t *c = &bench_cases[i];
+        if (filter != NULL && strstr(c->name, filter) == NULL) {
+            continue;
+        }
+        if (c->prepare != NULL) {
+            c->prepare(c);
+        }
+
+        // Warm up, then double the ops until one repetition is long enough
+        uint64_t frames;
+        uint64_t ops = 1;
+        time_ops(c, ops, &frames);
+        while (time_ops(c, ops, &frames) < min_ns / repeat && ops < (1ULL << 40)) {
+            ops *= 2;
+        }
+
+        int64_t best_ns = INT64_MAX;
+        uint64_t best_frames = 0;
+        uint64_t allocs = bench_allocations();
+        for (int r = 0; r < repeat; r++) {
+            int64_t ns = time_ops(c, ops, &frames);
+            if (ns < best_ns) {
+                best_ns = ns;
+                best_frames = frames;
+            }
+        }
+        double allocs_op = (double)(bench_allocations() - allocs) / ((double)ops * repeat);
+        double ns_op = (double)best_ns / ops;
+        double ops_s = 1e9 / ns_op;
+
+        printf("%-24s %12.1f", c->name, ns_op);
+        if (best_frames > 0) {
+            double ns_frame = (double)best_ns / best_frames;
+            printf(" %10.1f", ns_frame);
+            printf(" %10.2f %12.0f %10.1f", allocs_op, ops_s, 1e9 / ns_frame / bus_max_fps);
+        } else {
+            printf(" %10s %10.2f %12.0f %10s", "-", allocs_op, ops_s, "-");
+        }
+
+        if (compare_path != NULL) {
+            const result_t *base = find_baseline(c->name);
+            if (base == NULL) {
+                printf(" %9s", "new");
+            } else {
+                double delta = (ns_op - base->ns_op) * 100.0 / base->ns_op;
+                printf(" %+8.1f%%", delta);
+                if (delta > threshold || allocs_op > base->allocs_op + 0.005) {
+                    printf("  REGRESSION");
+                    regressions++;
+                }
+            }
+        }
+        printf("\n");
+        if (save != NULL) {
+            fprintf(save, "%s %.2f %.3f\n", c->name, ns_op, allocs_op);
+        }
+    }
+
+    if (save != NULL) {
+        fclose(save);
+    }
+    if (regressions > 0) {
+        printf("%d case(s) regressed by more than %.1f%%\n", regressions, threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+// Only what the compiled sources reference. The handlers are linked but
+// never called.
+
+typedef void *httpd_handle_t;
+typedef enum { HTTP_DELETE, HTTP_GET, HTTP_POST, HTTP_PUT } httpd_method_t;
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int method;
+    size_t content_len;
+    void *user_ctx;
+} httpd_req_t;
+
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+} httpd_uri_t;
+
+typedef enum {
+    HTTPD_400_BAD_REQUEST,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_408_REQ_TIMEOUT,
+    HTTPD_500_INTERNAL_SERVER_ERROR,
+} httpd_err_code_t;
+
+#define HTTPD_RESP_USE_STRLEN   -1
+#define HTTPD_SOCK_ERR_TIMEOUT  -3
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t server, const httpd_uri_t *uri);
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t len);
+esp_err_t httpd_resp_sendstr(httpd_req_t *req, const char *str);
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t code, const char *msg);
+esp_err_t httpd_resp_send_500(httpd_req_t *req);
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value);
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *req, char *buf, size_t len);
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t len);
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t len);
@@ -0,0 +1,12 @@
+#pragma once
+
+// Logging is discarded; the arguments are still evaluated, as on the device.
+static inline void bench_log_discard(const char *tag, const char *fmt, ...) {
+    (void)tag;
+    (void)fmt;
+}
+
+#define ESP_LOGE(tag, ...) bench_log_discard(tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) bench_log_discard(tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) bench_log_discard(tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) bench_log_discard(tag, __VA_ARGS__)
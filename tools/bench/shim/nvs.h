@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// An empty NVS: sequences always come from the built-in scripts.
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+typedef enum { NVS_TYPE_STR = 0x21 } nvs_type_t;
+typedef struct nvs_opaque_iterator_t *nvs_iterator_t;
+
+typedef struct {
+    char namespace_name[16];
+    char key[16];
+    nvs_type_t type;
+} nvs_entry_info_t;
+
+#define NVS_DEFAULT_PART_NAME "nvs"
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out, size_t *len);
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_entry_find(const char *part, const char *ns, nvs_type_t type, nvs_iterator_t *it);
+esp_err_t nvs_entry_next(nvs_iterator_t *it);
+esp_err_t nvs_entry_info(nvs_iterator_t it, nvs_entry_info_t *out);
+void nvs_release_iterator(nvs_iterator_t it);
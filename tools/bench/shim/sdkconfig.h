@@ -0,0 +1,4 @@
+#pragma once
+
+// Host build: no ISR dispatch for esp_timer, no power management.
+#define CONFIG_IDF_TARGET_LINUX 1
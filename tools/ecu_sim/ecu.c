@@ -0,0 +1,249 @@
+#include "ecu_sim.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/can.h>
+
+// Steering ECU on the 0x742/0x762 pair. Requests arrive as ISO-TP single
+// frames; responses longer than 7 bytes go out as a first frame followed
+// by consecutive frames paced by the tester's flow control, the way the
+// firmware's ISO-TP transport expects them.
+
+#define PCI_SINGLE      0x0
+#define PCI_FIRST       0x1
+#define PCI_CONSECUTIVE 0x2
+#define PCI_FLOW        0x3
+
+#define FC_TIMEOUT_MS       1000    // N_Bs
+#define MAX_RESPONSE        64
+#define STATUS_RESPONSE_LEN 26      // 61 01 + data, status in byte 22
+
+static const ecu_config_t *ecu_cfg;
+static ecu_stats_t *ecu_stats;
+static int ecu_fd = -1;
+static pthread_t ecu_thread;
+static atomic_bool ecu_running;
+static unsigned ecu_seed;
+static _Atomic int64_t last_tx_us;     // 0 between sequences
+static atomic_bool calibrated;          // --learn: angle_config has run
+
+// Sends one frame unless the drop rate says it is lost.
+static void send_frame(const uint8_t *data) {
+    if (ecu_cfg->drop_rate > 0 && (double)rand_r(&ecu_seed) / RAND_MAX < ecu_cfg->drop_rate) {
+        atomic_fetch_add(&ecu_stats->dropped, 1);
+        return;
+    }
+    struct can_frame cf = {.can_id = ecu_cfg->response_id, .can_dlc = 8};
+    memcpy(cf.data, data, 8);
+    if (write(ecu_fd, &cf, sizeof(cf)) != sizeof(cf)) {
+        perror("ecu write");
+    }
+    atomic_store(&last_tx_us, sim_now_us());
+}
+
+static void sleep_us(uint32_t us) {
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000};
+    while (us > 0 && nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+// STmin in ISO-TP encoding to microseconds
+static uint32_t st_min_us(uint8_t st) {
+    if (st <= 0x7F) {
+        return st * 1000u;
+    }
+    if (st >= 0xF1 && st <= 0xF9) {
+        return (st - 0xF0) * 100u;
+    }
+    return 127000;
+}
+
+// Waits for the tester's flow control. Returns false on timeout.
+static bool wait_flow_control(uint8_t *bs, uint8_t *st) {
+    int64_t deadline = sim_now_us() + FC_TIMEOUT_MS * 1000;
+    while (atomic_load(&ecu_running)) {
+        int64_t left = deadline - sim_now_us();
+        struct pollfd pfd = {.fd = ecu_fd, .events = POLLIN};
+        if (left <= 0 || poll(&pfd, 1, (int)((left + 999) / 1000)) <= 0) {
+            break;
+        }
+        struct can_frame cf;
+        if (read(ecu_fd, &cf, sizeof(cf)) != sizeof(cf) || cf.can_dlc < 3 || (cf.data[0] >> 4) != PCI_FLOW) {
+            continue;
+        }
+        if ((cf.data[0] & 0x0F) != 0) {     // WAIT or OVERFLOW
+            deadline = sim_now_us() + FC_TIMEOUT_MS * 1000;
+            if ((cf.data[0] & 0x0F) == 1) {
+                continue;
+            }
+            return false;
+        }
+        *bs = cf.data[1];
+        *st = cf.data[2];
+        return true;
+    }
+    atomic_fetch_add(&ecu_stats->fc_timeouts, 1);
+    return false;
+}
+
+static void send_message(const uint8_t *payload, size_t len) {
+    uint8_t data[8];
+    memset(data, 0x00, sizeof(data));
+    if (len <= 7) {
+        data[0] = (uint8_t)(PCI_SINGLE << 4 | len);
+        memcpy(&data[1], payload, len);
+        send_frame(data);
+        return;
+    }
+
+    atomic_fetch_add(&ecu_stats->multi_frame, 1);
+    data[0] = (uint8_t)(PCI_FIRST << 4 | (len >> 8));
+    data[1] = (uint8_t)len;
+    memcpy(&data[2], payload, 6);
+    int64_t ff_us = sim_now_us();
+    send_frame(data);
+
+    size_t off = 6;
+    uint8_t sn = 1, bs, st;
+    while (off < len) {
+        if (!wait_flow_control(&bs, &st)) {
+            return;
+        }
+        if (ff_us != 0) {
+            samples_add(&ecu_stats->flow_control, sim_now_us() - ff_us);
+            ff_us = 0;
+        }
+        for (unsigned n = 0; off < len && (bs == 0 || n < bs); n++) {
+            if (n > 0 || off > 6) {
+                sleep_us(st_min_us(st));
+            }
+            size_t chunk = len - off < 7 ? len - off : 7;
+            memset(data, 0x00, sizeof(data));
+            data[0] = (uint8_t)(PCI_CONSECUTIVE << 4 | (sn++ & 0x0F));
+            memcpy(&data[1], payload + off, chunk);
+            send_frame(data);
+            off += chunk;
+        }
+    }
+}
+
+static size_t negative(uint8_t *resp, uint8_t service, uint8_t code) {
+    resp[0] = 0x7F;
+    resp[1] = service;
+    resp[2] = code;
+    return 3;
+}
+
+// Builds the reply to one request, following what the firmware's built-in
+// sequences send.
+static size_t build_response(const uint8_t *req, size_t len, uint8_t *resp) {
+    uint8_t service = req[0];
+    if (ecu_cfg->nrc_code != 0 && service == ecu_cfg->nrc_service) {
+        return negative(resp, service, ecu_cfg->nrc_code);
+    }
+    switch (service) {
+    case 0x10:      // StartDiagnosticSession
+    case 0x3E:      // TesterPresent
+        resp[0] = service + 0x40;
+        resp[1] = len > 1 ? req[1] : 0;
+        return 2;
+    case 0x31:      // StartRoutineByLocalIdentifier
+        if (ecu_cfg->learn && len >= 3 && req[1] == 0x01 && req[2] == 0x01) {
+            atomic_store(&calibrated, true);     // last routine of angle_config
+        }
+        // fall through
+    case 0x14:      // ClearDiagnosticInformation
+        resp[0] = service + 0x40;
+        memcpy(&resp[1], &req[1], len > 3 ? 2 : len - 1);
+        return len > 3 ? 3 : len;
+    case 0x21:      // ReadDataByLocalIdentifier
+        if (len < 2) {
+            return negative(resp, service, 0x13);
+        }
+        resp[0] = 0x61;
+        resp[1] = req[1];
+        if (req[1] != 0x01) {
+            for (int i = 2; i < 6; i++) {
+                resp[i] = (uint8_t)(req[1] + i);
+            }
+            return 6;
+        }
+        for (int i = 2; i < STATUS_RESPONSE_LEN; i++) {
+            resp[i] = (uint8_t)(i * 7);
+        }
+        resp[20] = 0x00;
+        resp[22] = ecu_cfg->status == 4 || atomic_load(&calibrated) ? 0x8C : 0x83;
+        return STATUS_RESPONSE_LEN;
+    default:
+        return negative(resp, service, 0x11);
+    }
+}
+
+static void *ecu_task(void *arg) {
+    while (atomic_load(&ecu_running)) {
+        struct pollfd pfd = {.fd = ecu_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        struct can_frame cf;
+        if (read(ecu_fd, &cf, sizeof(cf)) != sizeof(cf)) {
+            continue;
+        }
+        int64_t rx_us = sim_now_us();
+        size_t len = cf.data[0] & 0x0F;
+        if ((cf.data[0] >> 4) != PCI_SINGLE || len == 0 || len > 7 || len >= cf.can_dlc) {
+            atomic_fetch_add(&ecu_stats->unexpected, 1);
+            continue;
+        }
+        atomic_fetch_add(&ecu_stats->requests, 1);
+        int64_t prev_tx_us = atomic_load(&last_tx_us);
+        if (prev_tx_us != 0) {
+            samples_add(&ecu_stats->turnaround, rx_us - prev_tx_us);
+        }
+
+        uint8_t resp[MAX_RESPONSE];
+        uint8_t pending[3];
+        size_t resp_len = build_response(&cf.data[1], len, resp);
+        for (int i = 0; i < ecu_cfg->pending; i++) {
+            sleep_us(ecu_cfg->delay_us);
+            send_message(pending, negative(pending, cf.data[1], 0x78));
+        }
+        sleep_us(ecu_cfg->delay_us);
+        if (resp[0] == 0x7F) {
+            atomic_fetch_add(&ecu_stats->negative, 1);
+        }
+        send_message(resp, resp_len);
+    }
+    return NULL;
+}
+
+int ecu_start(const ecu_config_t *cfg, ecu_stats_t *stats) {
+    ecu_fd = sim_can_open(cfg->ifname, cfg->request_id);
+    if (ecu_fd < 0) {
+        return -1;
+    }
+    ecu_cfg = cfg;
+    ecu_stats = stats;
+    ecu_seed = cfg->seed;
+    samples_init(&stats->turnaround, SIM_MAX_SAMPLES);
+    samples_init(&stats->flow_control, SIM_MAX_SAMPLES);
+    atomic_store(&ecu_running, true);
+    return pthread_create(&ecu_thread, NULL, ecu_task, NULL) == 0 ? 0 : -1;
+}
+
+void ecu_mark_idle(void) {
+    atomic_store(&last_tx_us, 0);
+}
+
+void ecu_stop(void) {
+    if (atomic_exchange(&ecu_running, false)) {
+        pthread_join(ecu_thread, NULL);
+        close(ecu_fd);
+        ecu_fd = -1;
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Host-side companion to the firmware: emulates the steering ECU on a
+// SocketCAN interface, loads the bus with background traffic and drives
+// the firmware's HTTP API to benchmark complete diagnostic sequences.
+
+#define SIM_BITRATE         500000
+#define SIM_MAX_SAMPLES     65536
+
+// Latency samples in microseconds, summarised as min/median/p95/max
+typedef struct {
+    uint32_t *values;
+    size_t count;
+    size_t cap;
+} sim_samples_t;
+
+void samples_init(sim_samples_t *s, size_t cap);
+void samples_add(sim_samples_t *s, int64_t us);
+void samples_print(const char *label, sim_samples_t *s, const char *unit, uint32_t div);
+void samples_free(sim_samples_t *s);
+
+int64_t sim_now_us(void);
+
+// Raw CAN socket on ifname. rx_id < 0 receives nothing.
+int sim_can_open(const char *ifname, int rx_id);
+
+// --- Steering ECU emulation (ecu.c) ---
+
+typedef struct {
+    const char *ifname;
+    uint16_t request_id;        // tester to ECU, 0x742
+    uint16_t response_id;       // ECU to tester, 0x762
+    int status;                 // 3 or 4, reported by ReadDataByLocalIdentifier 0x01
+    uint32_t delay_us;          // before every response
+    double drop_rate;           // probability a response frame is never sent
+    uint8_t nrc_service;        // answer this service with a negative response...
+    uint8_t nrc_code;           // ...using this NRC (0 disables)
+    int pending;                // "response pending" (7F xx 78) replies before each answer
+    bool learn;                 // report Status 3 until angle_config has run, then 4
+    unsigned seed;
+} ecu_config_t;
+
+typedef struct {
+    atomic_uint requests;
+    atomic_uint multi_frame;    // responses sent as first + consecutive frames
+    atomic_uint dropped;        // response frames withheld on purpose
+    atomic_uint negative;       // NRCs sent, "response pending" excluded
+    atomic_uint fc_timeouts;    // tester never sent flow control
+    atomic_uint unexpected;     // frames on the request ID that are not single-frame requests
+    sim_samples_t turnaround;   // our last response frame to the tester's next request
+    sim_samples_t flow_control; // our first frame to the tester's flow control
+} ecu_stats_t;
+
+int ecu_start(const ecu_config_t *cfg, ecu_stats_t *stats);
+
+// Marks the end of a sequence, so the next request does not count as a
+// turnaround.
+void ecu_mark_idle(void);
+
+void ecu_stop(void);
+
+// --- Background traffic (load.c) ---
+
+typedef struct {
+    const char *ifname;
+    double load;                // fraction of SIM_BITRATE, 0 disables
+    unsigned seed;
+    bool no_steering;           // leave 0x0C2 to the wheel (wheel.c)
+} load_config_t;
+
+typedef struct {
+    atomic_uint frames;
+    atomic_uint steering_frames;    // on 0x0C2, decoded by the firmware
+    atomic_uint tx_errors;
+    uint64_t bits;
+} load_stats_t;
+
+int load_start(const load_config_t *cfg, load_stats_t *stats);
+void load_stop(void);
+
+// --- Steering wheel (wheel.c) ---
+
+typedef struct {
+    atomic_uint frames;         // on 0x0C2
+    atomic_uint sweeps;
+} wheel_stats_t;
+
+// Broadcasts the steering angle at 100 Hz, resting at centre.
+int wheel_start(const char *ifname, wheel_stats_t *stats);
+
+// Turns the wheel to both end stops and back to centre (about 6 s).
+void wheel_sweep(void);
+bool wheel_sweeping(void);
+void wheel_stop(void);
+
+// --- Firmware HTTP client (http.c) ---
+
+// Sends a request and reads the whole response body into buf (NUL
+// terminated). Returns the HTTP status code, or -1 on a connection error.
+int http_request(const char *host, int port, const char *method, const char *path,
+                 char *buf, size_t cap);
+
+// Value of a JSON number field in body, or fallback if absent.
+int64_t json_int(const char *body, const char *key, int64_t fallback);
+
+// Value of an unlabelled Prometheus metric, or -1.
+int64_t prom_value(const char *body, const char *name);
@@ -0,0 +1,122 @@
+#include "ecu_sim.h"
+
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// Minimal blocking HTTP/1.1 client, one connection per request. Enough for
+// the firmware's JSON and metrics endpoints, including chunked responses.
+
+#define HTTP_TIMEOUT_S  30
+
+static int http_connect(const char *host, int port) {
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *res;
+    if (getaddrinfo(host, service, &hints, &res) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        struct timeval tv = {.tv_sec = HTTP_TIMEOUT_S};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+// Decodes a chunked body in place and returns its length.
+static size_t dechunk(char *body, size_t len) {
+    char *in = body, *out = body, *end = body + len;
+    while (in < end) {
+        char *line_end;
+        unsigned long size = strtoul(in, &line_end, 16);
+        line_end = strstr(line_end, "\r\n");
+        if (size == 0 || line_end == NULL || line_end + 2 + size > end) {
+            break;
+        }
+        memmove(out, line_end + 2, size);
+        out += size;
+        in = line_end + 2 + size + 2;
+    }
+    return (size_t)(out - body);
+}
+
+int http_request(const char *host, int port, const char *method, const char *path,
+                 char *buf, size_t cap) {
+    int fd = http_connect(host, port);
+    if (fd < 0) {
+        return -1;
+    }
+    char req[256];
+    int n = snprintf(req, sizeof(req),
+                     "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\nContent-Length: 0\r\n\r\n",
+                     method, path, host);
+    if (write(fd, req, n) != n) {
+        close(fd);
+        return -1;
+    }
+
+    size_t len = 0;
+    ssize_t r;
+    while (len < cap - 1 && (r = read(fd, buf + len, cap - 1 - len)) > 0) {
+        len += r;
+    }
+    close(fd);
+    buf[len] = '\0';
+
+    int status;
+    char *body = strstr(buf, "\r\n\r\n");
+    if (sscanf(buf, "HTTP/1.%*d %d", &status) != 1 || body == NULL) {
+        return -1;
+    }
+    *body = '\0';
+    bool chunked = strcasestr(buf, "Transfer-Encoding: chunked") != NULL;
+    body += 4;
+    len -= (size_t)(body - buf);
+    memmove(buf, body, len);
+    if (chunked) {
+        len = dechunk(buf, len);
+    }
+    buf[len] = '\0';
+    return status;
+}
+
+int64_t json_int(const char *body, const char *key, int64_t fallback) {
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(body, pattern);
+    if (p == NULL) {
+        return fallback;
+    }
+    p += strlen(pattern);
+    while (*p == ' ') {
+        p++;
+    }
+    char *end;
+    long long v = strtoll(p, &end, 10);
+    return end == p ? fallback : v;
+}
+
+int64_t prom_value(const char *body, const char *name) {
+    size_t n = strlen(name);
+    for (const char *p = body; (p = strstr(p, name)) != NULL; p += n) {
+        if ((p == body || p[-1] == '\n') && p[n] == ' ') {
+            return strtoll(p + n + 1, NULL, 10);
+        }
+    }
+    return -1;
+}
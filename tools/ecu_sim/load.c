@@ -0,0 +1,113 @@
+#include "ecu_sim.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/can.h>
+
+// Background traffic paced to a fraction of the nominal bitrate. Frames
+// are counted at their nominal length without stuff bits, the same way the
+// firmware estimates bus load, so --load 100 keeps a real 500 kbit/s bus
+// saturated. Identifiers are below 0x742, so on a real bus they also win
+// arbitration against the firmware's requests.
+
+#define STEERING_ANGLE_ID   0x0C2
+#define RESYNC_US           10000   // fall this far behind and pacing restarts
+
+// Round-robin mix: the steering broadcast the firmware decodes, ABS wheel
+// speeds, and traffic it must drop at the filter or the dispatcher
+static const uint16_t traffic_ids[] = {
+    STEERING_ANGLE_ID, 0x1A0, 0x280, 0x288, 0x320,
+    STEERING_ANGLE_ID, 0x4A0, 0x35B, 0x440, 0x5A0,
+};
+#define TRAFFIC_ID_COUNT (sizeof(traffic_ids) / sizeof(traffic_ids[0]))
+
+static const load_config_t *load_cfg;
+static load_stats_t *load_stats;
+static int load_fd = -1;
+static pthread_t load_thread;
+static atomic_bool load_running;
+
+static void fill_frame(struct can_frame *cf, uint16_t id, uint32_t n, unsigned *seed) {
+    cf->can_id = id;
+    cf->can_dlc = 8;
+    if (id == STEERING_ANGLE_ID) {
+        // Sweeps the angle so the decoded value keeps changing
+        uint16_t raw = (uint16_t)((n * 37u) % 0x3000u) | ((n & 1) ? 0x8000u : 0);
+        cf->data[0] = (uint8_t)raw;
+        cf->data[1] = (uint8_t)(raw >> 8);
+        memset(&cf->data[2], 0, 6);
+        return;
+    }
+    for (int i = 0; i < 8; i++) {
+        cf->data[i] = (uint8_t)rand_r(seed);
+    }
+}
+
+static void *load_task(void *arg) {
+    unsigned seed = load_cfg->seed;
+    uint32_t bits = 47 + 8 * 8;
+    int64_t interval_ns = (int64_t)(bits * 1e9 / (load_cfg->load * SIM_BITRATE));
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (uint32_t n = 0; atomic_load(&load_running); n++) {
+        struct can_frame cf;
+        uint16_t id = traffic_ids[n % TRAFFIC_ID_COUNT];
+        if (id == STEERING_ANGLE_ID && load_cfg->no_steering) {
+            id = 0x1A0;
+        }
+        fill_frame(&cf, id, n, &seed);
+        if (write(load_fd, &cf, sizeof(cf)) == sizeof(cf)) {
+            atomic_fetch_add(&load_stats->frames, 1);
+            if (id == STEERING_ANGLE_ID) {
+                atomic_fetch_add(&load_stats->steering_frames, 1);
+            }
+            load_stats->bits += bits;
+        } else if (errno == ENOBUFS) {
+            // Interface queue full: the bus is as busy as it gets
+            atomic_fetch_add(&load_stats->tx_errors, 1);
+        }
+
+        next.tv_nsec += interval_ns;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t behind_ns = (int64_t)(now.tv_sec - next.tv_sec) * 1000000000 + (now.tv_nsec - next.tv_nsec);
+        if (behind_ns > RESYNC_US * 1000) {
+            next = now;
+        } else if (behind_ns < 0) {
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+    }
+    return NULL;
+}
+
+int load_start(const load_config_t *cfg, load_stats_t *stats) {
+    if (cfg->load <= 0) {
+        return 0;
+    }
+    load_fd = sim_can_open(cfg->ifname, -1);
+    if (load_fd < 0) {
+        return -1;
+    }
+    load_cfg = cfg;
+    load_stats = stats;
+    atomic_store(&load_running, true);
+    return pthread_create(&load_thread, NULL, load_task, NULL) == 0 ? 0 : -1;
+}
+
+void load_stop(void) {
+    if (atomic_exchange(&load_running, false)) {
+        pthread_join(load_thread, NULL);
+        close(load_fd);
+        load_fd = -1;
+    }
+}
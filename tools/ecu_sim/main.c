@@ -0,0 +1,348 @@
+#include "ecu_sim.h"
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ecu_sim: steering ECU emulator, bus load generator and benchmark driver.
+//
+//   ecu_sim -i vcan0 --status 4 --load 80 --http 127.0.0.1:8080 --runs 50
+//
+// Without --http it only emulates the ECU and loads the bus, for manual
+// testing, until --duration expires or Ctrl-C. With --http it runs the
+// named sequence through POST /sequence/run --runs times, polling each
+// job until it is done, and reports:
+//   - sequence completion time, host wall clock and device-measured
+//   - firmware turnaround: our response to its next request, on the bus
+//   - flow control latency: our first frame to its flow control
+//   - frames on 0x0C2 sent vs decoded (GET /signals) and RX overruns
+//   - firmware wake latency (GET /latency), to compare low-latency mode
+//     on and off under the same load
+// With --calibrate it runs the steering calibration instead (POST
+// /calibrate), turning the simulated wheel through its end stops while
+// GET /calibrate is polled, and reports how long each one took.
+// The same seed, load and runs give comparable numbers between builds.
+
+#define HTTP_BUF_SIZE   16384
+#define WARMUP_MS       500
+#define SETTLE_MS       200
+#define POLL_US         2000
+#define JOB_TIMEOUT_MS  10000
+#define CALIB_POLL_MS   50
+#define CALIB_TIMEOUT_MS 30000
+#define SWEEP_REPEAT_S  10      // --wheel without --http
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig) {
+    stop_requested = 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -i, --interface IF     SocketCAN interface (vcan0)\n"
+            "      --status 3|4       status reported by the emulated ECU (4)\n"
+            "      --delay-us N       delay before every response (0)\n"
+            "      --drop P           probability a response frame is lost (0)\n"
+            "      --nrc SID:CODE     answer service SID with NRC CODE (hex)\n"
+            "      --pending N        response-pending replies before each answer (0)\n"
+            "      --learn            report Status 4 once angle_config has run\n"
+            "      --load PERCENT     background bus load (0)\n"
+            "      --seed N           random seed (1)\n"
+            "      --wheel            simulate the steering wheel on 0x0C2, sweeping\n"
+            "                         it every %d s without --http\n"
+            "      --duration S       run time without --http, 0 = until Ctrl-C\n"
+            "      --http HOST[:PORT] firmware web server to benchmark\n"
+            "      --sequence NAME    sequence to run (status_check)\n"
+            "      --runs N           sequence or calibration runs (20)\n"
+            "      --calibrate        benchmark calibration instead (implies --wheel)\n",
+            prog, SWEEP_REPEAT_S);
+}
+
+// Firmware counters compared before and after the benchmark
+typedef struct {
+    int64_t steering_updates;
+    int64_t rx_overruns;
+    int64_t rx_frames;
+    bool low_latency;
+    int64_t wake_p50_us;
+    int64_t wake_p99_us;
+    int64_t wake_max_us;
+} fw_snapshot_t;
+
+// Submits a run and polls the job until it is done. Returns the HTTP status
+// of the last response, with the job in buf.
+static int run_job(const char *host, int port, const char *path, char *buf) {
+    int status = http_request(host, port, "POST", path, buf, HTTP_BUF_SIZE);
+    int64_t id = json_int(buf, "id", 0);
+    if (status != 202 || id == 0) {
+        return status;
+    }
+    char job_path[48];
+    snprintf(job_path, sizeof(job_path), "/jobs?id=%lld", (long long)id);
+    int64_t deadline = sim_now_us() + JOB_TIMEOUT_MS * 1000LL;
+    while (status == 202 && sim_now_us() < deadline && !stop_requested) {
+        usleep(POLL_US);
+        status = http_request(host, port, "GET", job_path, buf, HTTP_BUF_SIZE);
+    }
+    return status;
+}
+
+// Starts a calibration, sweeps the wheel and polls until it is done or
+// failed. Returns the HTTP status of the last response, with the state in
+// buf.
+static int run_calibration(const char *host, int port, char *buf) {
+    int status = http_request(host, port, "POST", "/calibrate", buf, HTTP_BUF_SIZE);
+    if (status != 202) {
+        return status;
+    }
+    wheel_sweep();
+    int64_t deadline = sim_now_us() + CALIB_TIMEOUT_MS * 1000LL;
+    while (status == 200 || status == 202) {
+        if (strstr(buf, "\"phase\":\"done\"") != NULL || strstr(buf, "\"phase\":\"failed\"") != NULL) {
+            break;
+        }
+        if (sim_now_us() >= deadline || stop_requested) {
+            http_request(host, port, "DELETE", "/calibrate", buf, HTTP_BUF_SIZE);
+            break;
+        }
+        usleep(CALIB_POLL_MS * 1000);
+        status = http_request(host, port, "GET", "/calibrate", buf, HTTP_BUF_SIZE);
+    }
+    // Back at centre before the next run
+    while (wheel_sweeping() && !stop_requested) {
+        usleep(CALIB_POLL_MS * 1000);
+    }
+    return status;
+}
+
+static int fw_snapshot(const char *host, int port, char *buf, fw_snapshot_t *s) {
+    if (http_request(host, port, "GET", "/signals?name=steering_angle", buf, HTTP_BUF_SIZE) != 200) {
+        return -1;
+    }
+    s->steering_updates = json_int(buf, "updates", -1);
+    if (http_request(host, port, "GET", "/metrics", buf, HTTP_BUF_SIZE) != 200) {
+        return -1;
+    }
+    s->rx_overruns = prom_value(buf, "can_rx_overruns_total");
+    s->rx_frames = prom_value(buf, "can_rx_frames_total");
+    if (http_request(host, port, "GET", "/latency", buf, HTTP_BUF_SIZE) == 200) {
+        s->low_latency = strstr(buf, "\"mode\":\"on\"") != NULL;
+        s->wake_p50_us = json_int(buf, "p50_us", -1);
+        s->wake_p99_us = json_int(buf, "p99_us", -1);
+        s->wake_max_us = json_int(buf, "max_us", -1);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    ecu_config_t ecu = {
+        .ifname = "vcan0",
+        .request_id = 0x742,
+        .response_id = 0x762,
+        .status = 4,
+        .seed = 1,
+    };
+    load_config_t load = {.ifname = "vcan0", .seed = 1};
+    const char *http = NULL, *sequence = "status_check";
+    int runs = 20, duration_s = 0;
+    bool wheel = false, calibrate = false;
+
+    static const struct option options[] = {
+        {"interface", required_argument, NULL, 'i'},
+        {"status", required_argument, NULL, 's'},
+        {"delay-us", required_argument, NULL, 'd'},
+        {"drop", required_argument, NULL, 'p'},
+        {"nrc", required_argument, NULL, 'n'},
+        {"pending", required_argument, NULL, 'w'},
+        {"load", required_argument, NULL, 'l'},
+        {"seed", required_argument, NULL, 'r'},
+        {"duration", required_argument, NULL, 't'},
+        {"http", required_argument, NULL, 'h'},
+        {"sequence", required_argument, NULL, 'q'},
+        {"runs", required_argument, NULL, 'c'},
+        {"learn", no_argument, NULL, 'L'},
+        {"wheel", no_argument, NULL, 'W'},
+        {"calibrate", no_argument, NULL, 'C'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    unsigned sid, code;
+    while ((opt = getopt_long(argc, argv, "i:", options, NULL)) != -1) {
+        switch (opt) {
+        case 'i': ecu.ifname = load.ifname = optarg; break;
+        case 's': ecu.status = atoi(optarg); break;
+        case 'd': ecu.delay_us = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'p': ecu.drop_rate = atof(optarg); break;
+        case 'n':
+            if (sscanf(optarg, "%x:%x", &sid, &code) != 2) {
+                usage(argv[0]);
+                return 2;
+            }
+            ecu.nrc_service = (uint8_t)sid;
+            ecu.nrc_code = (uint8_t)code;
+            break;
+        case 'w': ecu.pending = atoi(optarg); break;
+        case 'l': load.load = atof(optarg) / 100.0; break;
+        case 'r': ecu.seed = load.seed = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 't': duration_s = atoi(optarg); break;
+        case 'h': http = optarg; break;
+        case 'q': sequence = optarg; break;
+        case 'c': runs = atoi(optarg); break;
+        case 'L': ecu.learn = true; break;
+        case 'W': wheel = true; break;
+        case 'C': calibrate = wheel = true; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if ((ecu.status != 3 && ecu.status != 4) || (calibrate && http == NULL)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    char host[128];
+    int port = 80;
+    if (http != NULL) {
+        snprintf(host, sizeof(host), "%s", http);
+        char *colon = strrchr(host, ':');
+        if (colon != NULL) {
+            *colon = '\0';
+            port = atoi(colon + 1);
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    ecu_stats_t ecu_stats = {0};
+    load_stats_t load_stats = {0};
+    wheel_stats_t wheel_stats = {0};
+    load.no_steering = wheel;
+    if (ecu_start(&ecu, &ecu_stats) != 0) {
+        return 1;
+    }
+
+    char *buf = malloc(HTTP_BUF_SIZE);
+    fw_snapshot_t before = {0}, after = {0};
+    bool have_snapshots = false;
+    if (http != NULL && fw_snapshot(host, port, buf, &before) != 0) {
+        fprintf(stderr, "Cannot reach the firmware at %s:%d\n", host, port);
+        ecu_stop();
+        return 1;
+    }
+    if (load_start(&load, &load_stats) != 0 || (wheel && wheel_start(ecu.ifname, &wheel_stats) != 0)) {
+        load_stop();
+        ecu_stop();
+        return 1;
+    }
+    int64_t start_us = sim_now_us();
+
+    sim_samples_t wall, device;
+    samples_init(&wall, runs > 0 ? runs : 1);
+    samples_init(&device, runs > 0 ? runs : 1);
+    int failures = 0, wrong_status = 0;
+    if (calibrate) {
+        usleep(WARMUP_MS * 1000);
+        for (int i = 0; i < runs && !stop_requested; i++) {
+            int64_t t0 = sim_now_us();
+            int status = run_calibration(host, port, buf);
+            int64_t t1 = sim_now_us();
+            if (status != 200 || strstr(buf, "\"phase\":\"done\"") == NULL) {
+                failures++;
+                fprintf(stderr, "calibration %d: HTTP %d %s\n", i, status, status > 0 ? buf : "");
+                continue;
+            }
+            samples_add(&wall, t1 - t0);
+            samples_add(&device, json_int(buf, "elapsed_ms", 0) * 1000);
+        }
+    } else if (http != NULL) {
+        usleep(WARMUP_MS * 1000);
+        char path[64];
+        snprintf(path, sizeof(path), "/sequence/run?name=%s", sequence);
+        for (int i = 0; i < runs && !stop_requested; i++) {
+            ecu_mark_idle();
+            int64_t t0 = sim_now_us();
+            int status = run_job(host, port, path, buf);
+            int64_t t1 = sim_now_us();
+            if (status != 200 || strstr(buf, "\"result\":\"ESP_OK\"") == NULL) {
+                failures++;
+                fprintf(stderr, "run %d: HTTP %d %s\n", i, status, status > 0 ? buf : "");
+                continue;
+            }
+            samples_add(&wall, t1 - t0);
+            samples_add(&device, json_int(buf, "elapsed_us", 0));
+            int reported = (int)json_int(buf, "status", 0);
+            if (reported != 0 && reported != ecu.status) {
+                wrong_status++;
+            }
+        }
+    } else {
+        int64_t next_sweep_us = start_us;
+        while (!stop_requested && (duration_s == 0 || sim_now_us() - start_us < duration_s * 1000000LL)) {
+            if (wheel && sim_now_us() >= next_sweep_us) {
+                wheel_sweep();
+                next_sweep_us += SWEEP_REPEAT_S * 1000000LL;
+            }
+            usleep(100000);
+        }
+    }
+
+    wheel_stop();
+    load_stop();
+    double elapsed_s = (sim_now_us() - start_us) / 1e6;
+    if (http != NULL) {
+        usleep(SETTLE_MS * 1000);
+        have_snapshots = fw_snapshot(host, port, buf, &after) == 0;
+    }
+    ecu_stop();
+
+    printf("interface              %s, %.1f s\n", ecu.ifname, elapsed_s);
+    printf("background load        %u frames (%.0f frames/s, %.1f %% of %d bit/s), %u on 0x0C2, %u refused\n",
+           atomic_load(&load_stats.frames), atomic_load(&load_stats.frames) / elapsed_s,
+           load_stats.bits / elapsed_s * 100.0 / SIM_BITRATE, SIM_BITRATE,
+           atomic_load(&load_stats.steering_frames), atomic_load(&load_stats.tx_errors));
+    printf("ecu                    %u requests, %u multi-frame, %u dropped, %u NRC, %u FC timeouts, %u unexpected\n",
+           atomic_load(&ecu_stats.requests), atomic_load(&ecu_stats.multi_frame), atomic_load(&ecu_stats.dropped),
+           atomic_load(&ecu_stats.negative), atomic_load(&ecu_stats.fc_timeouts), atomic_load(&ecu_stats.unexpected));
+    samples_print("firmware turnaround", &ecu_stats.turnaround, "us", 1);
+    samples_print("flow control latency", &ecu_stats.flow_control, "us", 1);
+    unsigned steering_sent = atomic_load(&load_stats.steering_frames) + atomic_load(&wheel_stats.frames);
+    if (wheel) {
+        printf("wheel                  %u frames on 0x0C2, %u sweeps\n",
+               atomic_load(&wheel_stats.frames), atomic_load(&wheel_stats.sweeps));
+    }
+    if (calibrate) {
+        printf("calibration            %d runs, %d failed\n", runs, failures);
+        samples_print("  wall clock", &wall, "ms", 1000);
+        samples_print("  device elapsed", &device, "ms", 1000);
+    } else if (http != NULL) {
+        printf("sequence %-13s %d runs, %d failed, %d wrong status\n", sequence, runs, failures, wrong_status);
+        samples_print("  wall clock", &wall, "ms", 1000);
+        samples_print("  device elapsed", &device, "ms", 1000);
+    }
+    if (http != NULL) {
+        if (have_snapshots) {
+            int64_t decoded = after.steering_updates - before.steering_updates;
+            printf("frames lost            0x0C2: %u sent, %lld decoded, %lld lost; RX overruns +%lld, RX frames +%lld\n",
+                   steering_sent, (long long)decoded, (long long)(steering_sent - decoded),
+                   (long long)(after.rx_overruns - before.rx_overruns),
+                   (long long)(after.rx_frames - before.rx_frames));
+            printf("wake latency           low-latency mode %s: p50 %lld us, p99 %lld us, max %lld us\n",
+                   after.low_latency ? "on" : "off", (long long)after.wake_p50_us,
+                   (long long)after.wake_p99_us, (long long)after.wake_max_us);
+        }
+    }
+
+    samples_free(&wall);
+    samples_free(&device);
+    samples_free(&ecu_stats.turnaround);
+    samples_free(&ecu_stats.flow_control);
+    free(buf);
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+#include "ecu_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+int64_t sim_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int sim_can_open(const char *ifname, int rx_id) {
+    int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct ifreq ifr = {0};
+    strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name) - 1);
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+        fprintf(stderr, "%s: no such CAN interface\n", ifname);
+        close(fd);
+        return -1;
+    }
+
+    struct can_filter kf = {.can_id = (canid_t)rx_id, .can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG};
+    setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, &kf, rx_id < 0 ? 0 : sizeof(kf));
+
+    struct sockaddr_can addr = {.can_family = AF_CAN, .can_ifindex = ifr.ifr_ifindex};
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void samples_init(sim_samples_t *s, size_t cap) {
+    s->values = calloc(cap, sizeof(s->values[0]));
+    s->count = 0;
+    s->cap = s->values != NULL ? cap : 0;
+}
+
+// Keeps the first cap samples; runs are meant to be short and repeatable.
+void samples_add(sim_samples_t *s, int64_t us) {
+    if (s->count < s->cap) {
+        s->values[s->count++] = us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    }
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void samples_print(const char *label, sim_samples_t *s, const char *unit, uint32_t div) {
+    if (s->count == 0) {
+        printf("%-22s no samples\n", label);
+        return;
+    }
+    qsort(s->values, s->count, sizeof(s->values[0]), cmp_u32);
+    printf("%-22s n=%-6zu min %8.2f  median %8.2f  p95 %8.2f  max %8.2f %s\n", label, s->count,
+           (double)s->values[0] / div, (double)s->values[s->count / 2] / div,
+           (double)s->values[(s->count * 95) / 100] / div, (double)s->values[s->count - 1] / div, unit);
+}
+
+void samples_free(sim_samples_t *s) {
+    free(s->values);
+    s->values = NULL;
+    s->count = s->cap = 0;
+}
@@ -0,0 +1,129 @@
+#include "ecu_sim.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/can.h>
+
+// Steering angle broadcast (Lenkwinkel_1 on 0x0C2) driven by a technician
+// profile: from centre to the left stop, to the right stop and back to
+// centre, holding each stop briefly. The whole profile is offset as an
+// uncalibrated sensor would be.
+
+#define STEERING_ANGLE_ID   0x0C2
+#define PERIOD_US           10000   // 100 Hz, as on the car
+#define LOCK_DEG            520.0
+#define SENSOR_OFFSET_DEG   3.5
+#define TURN_RATE_DEG_S     360.0
+#define SETTLE_MS           500
+#define STOP_HOLD_MS        800
+
+static int wheel_fd = -1;
+static pthread_t wheel_thread;
+static atomic_bool wheel_running;
+static _Atomic int64_t sweep_start_us;     // 0 while resting at centre
+static wheel_stats_t *wheel_stats;
+
+// Profile segments: target angle and time to reach it (a ramp), or to stay
+// there (a hold).
+typedef struct {
+    double angle;
+    double ms;
+} segment_t;
+
+static segment_t profile[] = {
+    {0, SETTLE_MS},
+    {-LOCK_DEG, LOCK_DEG / TURN_RATE_DEG_S * 1000},
+    {-LOCK_DEG, STOP_HOLD_MS},
+    {LOCK_DEG, 2 * LOCK_DEG / TURN_RATE_DEG_S * 1000},
+    {LOCK_DEG, STOP_HOLD_MS},
+    {0, LOCK_DEG / TURN_RATE_DEG_S * 1000},
+};
+#define SEGMENT_COUNT (sizeof(profile) / sizeof(profile[0]))
+
+// Angle and rate t_ms into the sweep; *done once it is back at centre.
+static void profile_at(double t_ms, double *angle, double *rate, bool *done) {
+    double from = 0;
+    for (size_t i = 0; i < SEGMENT_COUNT; i++) {
+        if (t_ms < profile[i].ms) {
+            *rate = (profile[i].angle - from) / profile[i].ms * 1000;
+            *angle = from + *rate * t_ms / 1000;
+            *done = false;
+            return;
+        }
+        t_ms -= profile[i].ms;
+        from = profile[i].angle;
+    }
+    *angle = 0;
+    *rate = 0;
+    *done = true;
+}
+
+// Sign and 15-bit magnitude, 0.04375 per bit
+static uint16_t encode(double value) {
+    double magnitude = (value < 0 ? -value : value) / 0.04375;
+    uint16_t raw = magnitude > 0x7FFF ? 0x7FFF : (uint16_t)(magnitude + 0.5);
+    return raw | (value < 0 ? 0x8000 : 0);
+}
+
+static void *wheel_task(void *arg) {
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (atomic_load(&wheel_running)) {
+        double angle = 0, rate = 0;
+        int64_t start_us = atomic_load(&sweep_start_us);
+        if (start_us != 0) {
+            bool done;
+            profile_at((sim_now_us() - start_us) / 1000.0, &angle, &rate, &done);
+            if (done) {
+                atomic_store(&sweep_start_us, 0);
+            }
+        }
+        uint16_t raw_angle = encode(angle + SENSOR_OFFSET_DEG), raw_rate = encode(rate);
+        struct can_frame cf = {.can_id = STEERING_ANGLE_ID, .can_dlc = 8};
+        cf.data[0] = (uint8_t)raw_angle;
+        cf.data[1] = (uint8_t)(raw_angle >> 8);
+        cf.data[2] = (uint8_t)raw_rate;
+        cf.data[3] = (uint8_t)(raw_rate >> 8);
+        if (write(wheel_fd, &cf, sizeof(cf)) == sizeof(cf)) {
+            atomic_fetch_add(&wheel_stats->frames, 1);
+        }
+
+        next.tv_nsec += PERIOD_US * 1000;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+int wheel_start(const char *ifname, wheel_stats_t *stats) {
+    wheel_fd = sim_can_open(ifname, -1);
+    if (wheel_fd < 0) {
+        return -1;
+    }
+    wheel_stats = stats;
+    atomic_store(&wheel_running, true);
+    return pthread_create(&wheel_thread, NULL, wheel_task, NULL) == 0 ? 0 : -1;
+}
+
+void wheel_sweep(void) {
+    atomic_store(&sweep_start_us, sim_now_us());
+    atomic_fetch_add(&wheel_stats->sweeps, 1);
+}
+
+bool wheel_sweeping(void) {
+    return atomic_load(&sweep_start_us) != 0;
+}
+
+void wheel_stop(void) {
+    if (atomic_exchange(&wheel_running, false)) {
+        pthread_join(wheel_thread, NULL);
+        close(wheel_fd);
+        wheel_fd = -1;
+    }
+}